@@ -0,0 +1,275 @@
+#!/bin/sh
+# Runs every benchmark of the suite several times with fixed inputs, prints the median and p95 wall time
+# and the instructions per second, then compares the medians with the saved baseline.
+#
+# usage: bench/run.sh [-n runs] [-f fsnail] [-b baseline.json] [-t threshold] [-s] [-c] [-p] [-r] [-o]
+#   -n runs       Number of timed runs of every benchmark (default 10)
+#   -f fsnail     Interpreter to measure (default ./fsnail)
+#   -b file       Baseline to compare with (default bench/baseline.json)
+#   -t threshold  Slowdown in percent flagged as a regression (default 10)
+#   -s            Saves the results as the new baseline
+#   -c            Also translates the README examples and every benchmark with --emit-c, checks that the native
+#                 programs print the same output with the same exit status as the interpreter and measures them
+#   -p            Also runs every benchmark with --perf-counters and prints its instructions per cycle and its
+#                 branch and L1 data cache misses per machine instruction, when the cpu counters are available
+#   -r            Also runs every program of bench/regress and checks that its output and exit status are the
+#                 expected ones
+#   -o            Also prints 100000 random values with out, compiling a generator with cc (or $CC), and checks
+#                 that every one is printed like printf("%.3f") prints it
+#
+# The exit status is 1 when at least one benchmark is slower than the baseline by more than the threshold
+# or when a translated program, a regression program or a printed number differs from what is expected.
+
+BENCH=$(cd "$(dirname "$0")" && pwd)
+RUNS=10
+FSNAIL=./fsnail
+BASELINE=$BENCH/baseline.json
+THRESHOLD=10
+SAVE=0
+NATIVE=0
+PERF=0
+REGRESS=0
+OUTNUM=0
+CC=${CC:-cc}
+
+while getopts "n:f:b:t:scpro" opt; do
+    case $opt in
+        n) RUNS=$OPTARG ;;
+        f) FSNAIL=$OPTARG ;;
+        b) BASELINE=$OPTARG ;;
+        t) THRESHOLD=$OPTARG ;;
+        s) SAVE=1 ;;
+        c) NATIVE=1 ;;
+        p) PERF=1 ;;
+        r) REGRESS=1 ;;
+        o) OUTNUM=1 ;;
+        *) sed -n '5,19p' "$0"; exit 2 ;;
+    esac
+done
+
+FSNAIL=$(cd "$(dirname "$FSNAIL")" && pwd)/$(basename "$FSNAIL")
+if [ ! -x "$FSNAIL" ]; then
+    echo "The interpreter $FSNAIL does not exist, compile it with: gcc -O2 -o fsnail fsnail.c -lm"
+    exit 2
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cp "$BENCH"/*.fsn "$WORK"
+
+# The large source benchmark measures the parsing: a jump skips almost all of its lines
+awk 'BEGIN {
+    print "goto end"
+    for(i = 0; i < 20000; i++){
+        print "label block" i
+        print "    push " i " push 2 mult --> filler <--"
+        print "    load x pstore y"
+        print "    ifeq print \"never\" endif"
+    }
+    print "label end"
+    print "printnl \"parsed\""
+}' > "$WORK/parse.fsn"
+
+# The input of stdin.fsn: the number of values followed by the values
+awk 'BEGIN { print 50000; for(i = 0; i < 50000; i++) print i % 100 }' > "$WORK/stdin.in"
+
+input_of(){
+    if [ -f "$WORK/$1.in" ]; then echo "$WORK/$1.in"; else echo /dev/null; fi
+}
+
+# Prints the median of the wall times, in milliseconds, of RUNS runs of the given command
+time_runs(){
+    : > "$WORK/times"
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        start=$(date +%s%N)
+        "$@" < "$input" > /dev/null
+        end=$(date +%s%N)
+        echo $(( (end - start) / 1000 )) >> "$WORK/times"
+        i=$((i + 1))
+    done
+}
+
+printf "%-10s %10s %10s %12s %12s %8s\n" "benchmark" "median ms" "p95 ms" "Minstr/s" "baseline ms" "change"
+
+RESULTS=$WORK/results
+: > "$RESULTS"
+STATUS=0
+
+for prog in "$WORK"/*.fsn; do
+    name=$(basename "$prog" .fsn)
+    input=$(input_of "$name")
+
+    # A profiled run gives the number of executed instructions
+    "$FSNAIL" --profile "$prog" < "$input" > /dev/null 2>&1
+    instructions=$(sed -n 's/^  "instructions": \([0-9]*\),$/\1/p' "$prog.prof.json")
+    rm -f "$prog.prof.json"
+
+    time_runs "$FSNAIL" "$prog"
+
+    stats=$(sort -n "$WORK/times" | awk -v n="$instructions" '
+        { t[NR] = $1 }
+        END {
+            median = (NR % 2) ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2
+            p95 = t[int(NR * 0.95 + 0.999)]
+            printf "%.3f %.3f %.2f", median / 1000, p95 / 1000, median ? n / median : 0
+        }')
+    set -- $stats
+    median=$1 p95=$2 ips=$3
+
+    base=$(sed -n "s/^ *\"$name\": {\"median_ms\": \([0-9.]*\),.*/\1/p" "$BASELINE" 2>/dev/null)
+    change=$(awk -v m="$median" -v b="$base" -v t="$THRESHOLD" 'BEGIN {
+        if(b == "" || b == 0){ print "-"; exit }
+        c = (m - b) * 100 / b
+        printf "%+.1f%%%s", c, (c > t) ? " REGRESSION" : ""
+    }')
+    case $change in *REGRESSION) STATUS=1 ;; esac
+
+    printf "%-10s %10s %10s %12s %12s %8s\n" "$name" "$median" "$p95" "$ips" "${base:--}" "$change"
+    echo "$name $median $p95 $ips ${instructions:-0}" >> "$RESULTS"
+done
+
+# Translates the program with --emit-c and checks that the native program behaves like the interpreter
+native_matches(){
+    "$FSNAIL" --emit-c "$1" > "$WORK/native.c" && $CC -O2 -o "$2" "$WORK/native.c" -lm || return 1
+
+    "$FSNAIL" "$1" < "$input" > "$WORK/expected" 2>&1
+    expected=$?
+    "$2" < "$input" > "$WORK/actual" 2>&1
+    actual=$?
+    [ $expected -eq $actual ] && cmp -s "$WORK/expected" "$WORK/actual"
+}
+
+if [ $NATIVE -eq 1 ]; then
+    # The examples of the README, except the one that never ends, read their numbers from a fixed input
+    mkdir "$WORK/examples"
+    awk -v dir="$WORK/examples" '
+        /^## / { n++; skip = ($0 ~ /Infinite loop/) }
+        /^```/ { block = !block; next }
+        block && !skip { print > (dir "/example" n ".fsn") }' "$BENCH/../README.md"
+    printf "3\n5\n2\n1\n4\n2\n1\n" > "$WORK/examples.in"
+
+    input=$WORK/examples.in
+    for prog in "$WORK"/examples/*.fsn; do
+        if ! native_matches "$prog" "$WORK/example"; then
+            echo "README $(basename "$prog" .fsn): DIFFERENT"
+            STATUS=1
+        fi
+    done
+
+    printf "\n%-10s %10s %10s %8s\n" "benchmark" "native ms" "interp ms" "speedup"
+
+    while read -r name median rest; do
+        input=$(input_of "$name")
+
+        if ! native_matches "$WORK/$name.fsn" "$WORK/$name"; then
+            printf "%-10s %10s\n" "$name" "DIFFERENT"
+            STATUS=1
+            continue
+        fi
+
+        time_runs "$WORK/$name"
+        native=$(sort -n "$WORK/times" | awk '
+            { t[NR] = $1 }
+            END { printf "%.3f", ((NR % 2) ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2) / 1000 }')
+        speedup=$(awk -v n="$native" -v m="$median" 'BEGIN { if(n > 0) printf "%.1fx", m / n; else print "-" }')
+        printf "%-10s %10s %10s %8s\n" "$name" "$native" "$median" "$speedup"
+    done < "$RESULTS"
+fi
+
+if [ $PERF -eq 1 ]; then
+    printf "\n%-10s %8s %12s %12s\n" "benchmark" "IPC" "br-miss/i" "L1d-miss/i"
+
+    while read -r name rest; do
+        input=$(input_of "$name")
+
+        # The run line of the report holds the four counters, then the IPC and the two rates
+        report=$("$FSNAIL" --perf-counters "$WORK/$name.fsn" < "$input" 2>&1 > /dev/null)
+        counters=$(echo "$report" | awk '$1 == "run" { print $6, $7, $8 }')
+        if [ -z "$counters" ]; then
+            echo "$report" | sed -n 's/^PERF COUNTERS: unavailable/The cpu counters are unavailable/p'
+            break
+        fi
+
+        set -- $counters
+        printf "%-10s %8s %12s %12s\n" "$name" "$1" "$2" "$3"
+    done < "$RESULTS"
+fi
+
+if [ $REGRESS -eq 1 ]; then
+    # Every case is a directory with main.fsn, the files it includes and the expected output followed by
+    # the exit status, plus the options of the run in args and its input in input when they are needed
+    printf "\n%-20s %8s\n" "regression" "result"
+
+    for case in "$BENCH"/regress/*/; do
+        name=$(basename "$case")
+        rm -rf "$WORK/regress"
+        cp -r "$case" "$WORK/regress"
+        input=$WORK/regress/input
+        [ -f "$input" ] || input=/dev/null
+        args=$(cat "$WORK/regress/args" 2>/dev/null)
+
+        (cd "$WORK/regress" && "$FSNAIL" $args main.fsn < "$input" > actual 2>&1; echo $? >> actual)
+        if cmp -s "$WORK/regress/expected" "$WORK/regress/actual"; then
+            printf "%-20s %8s\n" "$name" "ok"
+        else
+            printf "%-20s %8s\n" "$name" "DIFFERENT"
+            STATUS=1
+        fi
+    done
+fi
+
+if [ $OUTNUM -eq 1 ]; then
+    # The generator writes a program that prints every value with out and the output printf gives for the same
+    # float: random magnitudes, values close to a half thousandth and exact ties, which are rounded to even
+    cat > "$WORK/outnum.c" <<'EOF'
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+int main(int argc, char *argv[]){
+    FILE *prog = fopen(argv[2], "w"), *expected = fopen(argv[3], "w");
+    char token[32];
+
+    srand(atoi(argv[1]));
+    for(int i = 0; i < 100000; i++){
+        double x;
+
+        switch(i % 3){
+        case 0: //Any magnitude a token can hold, with 9 significant digits
+            x = (rand() / (RAND_MAX + 1.0) + 0.1) * pow(10, rand() % 18 - 6);
+            snprintf(token, sizeof(token), "%.*f", (int)fmax(0, fmin(20, 9 - floor(log10(x)))), (rand() & 1) ? -x : x);
+            break;
+        case 1: //Halfway between two thousandths, up to the float rounding
+            snprintf(token, sizeof(token), "%s%d.%03d5", (rand() & 1) ? "-" : "", rand() % 100000, rand() % 1000);
+            break;
+        default: //Exact ties when the value is multiplied by 1000
+            snprintf(token, sizeof(token), "%.10f", (rand() % 1048576) / 1024.0);
+        }
+        fprintf(prog, "push %s out printnl \"\" pop\n", token);
+        fprintf(expected, "%.3f\n", (float)atof(token));
+    }
+    fclose(prog);
+    fclose(expected);
+    return 0;
+}
+EOF
+    seed=$(date +%s)
+    if $CC -O2 -o "$WORK/outnum" "$WORK/outnum.c" -lm && "$WORK/outnum" "$seed" "$WORK/outnum_check.fsn" "$WORK/outnum.expected" &&
+       "$FSNAIL" "$WORK/outnum_check.fsn" > "$WORK/outnum.actual" 2>&1 && cmp -s "$WORK/outnum.expected" "$WORK/outnum.actual"; then
+        printf "\nout matches printf on 100000 random values\n"
+    else
+        printf "\nout differs from printf, seed %s:\n" "$seed"
+        diff "$WORK/outnum.expected" "$WORK/outnum.actual" | head -5
+        STATUS=1
+    fi
+fi
+
+if [ $SAVE -eq 1 ]; then
+    awk 'BEGIN { print "{" }
+        { printf "%s  \"%s\": {\"median_ms\": %s, \"p95_ms\": %s, \"minstr_per_s\": %s, \"instructions\": %s}", (NR > 1) ? ",\n" : "", $1, $2, $3, $4, $5 }
+        END { print "\n}" }' "$RESULTS" > "$BASELINE"
+    echo "Baseline saved in $BASELINE"
+fi
+
+exit $STATUS
@@ -4,6 +4,20 @@
 #include <ctype.h>
 #include <math.h>
 #include <time.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
 /*
 List of operations:
@@ -14,6 +28,12 @@ Arithmetic and Stack operations:
     - dup: Duplicates the element on top of the stack
     - clear: Clears the stack content
     - swap: Swaps the two elements on top
+    - over: Copies the second element on top of the stack
+    - rot: Moves the third element on top of the stack
+    - pick value: Copies on top the element at the given distance from the top. Without a value, the distance is taken from the stack
+    - roll value: Moves on top the element at the given distance from the top. Without a value, the distance is taken from the stack
+    - drop value: Deletes the given number of elements from the top. Without a value, the number is taken from the stack
+    - depth: Adds on top the number of elements of the stack
     - sum: Sums the first two elements of the stack
     - sub: Same as sum but with the subtraction
     - mult: Same but with multiplication
@@ -22,6 +42,9 @@ Arithmetic and Stack operations:
     - toint: Converts the top element to an integer by rounding it down
     - inc name: Increments the top element value
     - dec name: Decrements the top element value
+    - sort value: Sorts the given number of elements on top of the stack, the greatest goes on top. Without a value, the whole stack is sorted
+    - rsort value: Same as sort but the smallest goes on top
+    - usort value: Same as sort but the repeated elements are kept only once
 
     The operations are always:
         second_element # first_element = result
@@ -55,11 +78,40 @@ Jumps and labels:
     - label name: Creates a new label
     - goto name: Jumps to the given label
 
+Loops:
+    - repeat value: Executes the code until endrepeat the given number of times. Without a value, the number is popped from the stack
+    - endrepeat: Ends the body of a repeat
+    - while condition: Executes the code until endwhile as long as the condition is true. The condition is one of eq, dif, gr, lw, true, false
+      and it's checked like the if with the same name, both before the first iteration and at every endwhile
+    - endwhile: Ends the body of a while
+    - index: Pushes on top of the stack the number of the current iteration of the innermost loop, starting from 0
+
+Subroutines:
+    - call name: Jumps to the given label, ret will continue from the next instruction
+    - ret: Returns to the instruction after the last call
+    - local name: Creates a local variable of the subroutine, every call has its own copy starting from 0
+
+    A subroutine starts at a label used by a call and ends where the next one starts. Inside it, load, store and pstore
+    use the local variables before the ones created with var
+
+Coroutines:
+    - cocreate name: Creates a coroutine that starts from the given label and pushes its handle on top of the stack
+    - resume: Pops the handle on top of the stack and the value under it, then continues the coroutine giving it the value on top of its stack
+    - yield: Pops the element on top of the stack of the coroutine and goes back to the resume, which pushes it on top of the stack
+
+    Every coroutine has its own stack, loops and calls, while the variables are shared. A ret outside of any call ends the coroutine
+    like a yield, after that its handle can't be resumed anymore
+
+Modules:
+    - include "file.fsn": Inserts the code of the file in place of the include, the path is relative to the file that contains it.
+      Every file is included only once, the following includes of the same file are ignored
+
 Input and output:
     - print "string": Prints the string X
     - printnl "string": Prints a string and goes to a new line
     - in: Gets the value as an integer, the value is stored in a new element on top of the stack
     - inchar: Gets the value as a char, the value is stored in a new element on top of the stack
+    - eof: Pushes 1 if the input has ended, 0 otherwise
     - out: Prints the element on top of the stack
     - outint: Prints the element on top of the stack as an integer
     - outchar: Prints the element on top of the stack as a character (treats the element as integers)
@@ -72,6 +124,9 @@ Variabiles:
     - pstore name: Saves the content of the stack top into the variable and pops it
     - load name: Loads the content of the variable on top of the stack
     - vclear: Clears variable stack content
+    - shvar name: Creates a variable in the shared memory segment given with --shm, its load, store and pstore are atomic
+    - fetchadd name: Pops the top element, adds it to the shared variable and pushes the previous value of the variable
+    - cas name: Pops the new value and the expected one below it, pushes 1 if the shared variable held the expected value and got the new one
 
 Comments and extra instructions:
     - -->: Starts the comment
@@ -82,6 +137,14 @@ Comments and extra instructions:
 
     The comment delimiters need to be separated as individual tokens
 
+Timing:
+    - clock: Pushes the nanoseconds passed since the start of the run, read from the monotonic clock
+    - mark name: Saves the current time in the mark with the given name
+    - elapsed name: Pushes the nanoseconds passed since the mark was saved
+    - timing name: Writes the name of the mark and the nanoseconds passed since it was saved on stderr, or in the file of --timings
+
+    The times are read without changing the stack or the output of the program, so a script can time its own phases
+
 Advanced Math:
     - abs: Returns the absolute value of the element on top of the stack
     - pow: Elevates the second to last number to the power of the top element (it acts exactly as the aritmethic operators)
@@ -111,202 +174,339 @@ struct link{
 typedef struct link l;
 typedef l *node;
 
+//The operand stack is an array, so every element is reached by its distance from the top without walking a list
+struct stack{
+    float *values; //values[0] is the bottom of the stack
+    int size;
+    int capacity;
+};
+
 typedef struct{
-    char string[D];
+    char *string; //Points inside the string pool
     int line; //Contains the position of the token in the file
+    int match; //For the loop instructions, the position of their counter part. For call, the position of the label. For the ifs, their endif
+    int slot; //For the variable instructions, the position of the local variable in the frame. For call, the size of the frame
+    //The optimizer writes its shortcuts in match and slot too, see its section
+    int file; //The module that contains the token, 0 is the file given to the interpreter
+    int shared; //For the variable instructions, the position of their shared variable among the names declared with shvar
 }token;
 
-node new_node(){
-    return malloc(sizeof(l));
-}
+struct{
+    int mem_stats; //Prints the memory report at the end of the run
+    int profile; //Counts and times every executed instruction
+    int trace; //Number of instructions kept by the trace
+    int sample; //Samples the running instruction on every millisecond of cpu time
+    int emit_c; //Prints the program translated to C instead of running it
+    long long max_steps; //Number of jumps after which the program is stopped
+    int timeout; //Milliseconds after which the program is stopped
+    char *record; //File that receives the inputs and the random seeds of the run
+    char *replay; //File recorded by --record, used instead of the real inputs
+    int watch; //Runs the program again every time its file changes
+    char *timings; //File that receives the samples of the timing instruction, stderr without it
+    char *coverage; //File that receives the executed lines
+    int shard; //Number of parts of the input, each one run by its own process
+    char *reduce; //Label where the run that merges the final stacks of the parts starts
+    char *shm; //Name of the shared memory segment of the shared variables
+    char *metrics; //File that receives the counters of the run, in the Prometheus text format when it ends with .prom
+    char *checkpoint; //File that receives the snapshots of the run
+    long long every; //Steps between two snapshots
+    char *restore; //Snapshot the run starts from
+    int perf_counters; //Reads the hardware counters of the cpu around the run
+    int perf_classes; //Also charges the counters to the class of every executed instruction
+}options;
+
+int instrumented = 0; //Set when at least one of the instruments needs to see every instruction
+volatile sig_atomic_t expired = 0; //Set by the timer of --timeout
+long long output_bytes = 0; //Bytes printed by the output instructions
+long long input_values = 0; //Values read by in and inchar
+
+#define MODULES 256 //Defines the maximum number of files that can be included
+#define CACHE_MAGIC "FSNC3"
+
+/*Every file is lexed only once: the tokens and the position of its labels are saved in a cache next to the source
+(file.fsnc), which is used as long as the source keeps the same size and modification time, down to the nanosecond. The linker splices the
+included files in place of their include, leaves out the labels of the modules that nothing jumps to and connects
+every goto to its label, so the whole program becomes a single array of tokens*/
+struct module{
+    char path[PATH_MAX];
+    token *code;
+    int elements;
+    int *labels; //Positions of the label instructions
+    int label_count;
+    int linked; //Set once the module is part of the program, every file is included only once
+};
 
-//Serves as a push
-void push(node *head, float v, char name[]){
-    node temp = *head;
-    
-    node new = new_node();
-    new->value = v;
-    strncpy(new->name, name, NAME_SIZE);
-    if(temp == NULL){ //If the stack is empty
-        new->next = *head; //Adds the new node before the current one
-        *head = new; //Updates the head node
-        return;
-    }
+struct module modules[MODULES];
+int module_count = 0;
+
+/*In watch mode the tokens of the main file stay in memory between the runs, with the state of the lexer at the
+beginning of every line and the table of the labels ordered by name. When the file changes only the lines that
+differ are lexed again and the tables are patched*/
+struct{
+    char *text; //The source that produced the tokens
+    long size;
+    token *code; //The tokens, followed by the final halt
+    int elements;
+    char *state; //The state of the lexer at the beginning of every line, from line 1
+    int lines;
+    int *labels; //Positions of the label instructions ordered by name and position
+    int label_count;
+}watch;
+
+//################################# - Memory section - #################################################
+
+#define ARENA_CHUNK 65536 //Defines the minimum size of an arena chunk
+#define ARENA_ALIGN 16
+
+//The arenas serve memory from big chunks, so everything they own is released at once when the run ends
+struct chunk{
+    struct chunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
 
-    while(temp->next != NULL) temp = temp->next; //Stops at the last element
-    new->next = temp->next; //Inserts the new node before the NULL one
-    temp->next = new; //Inserts the new node after the last one, effectively pushing the given value
-}
+struct arena{
+    char *name; //Used by the memory report
+    struct chunk *head;
+    size_t allocated; //Bytes handed out by the arena
+    size_t reserved; //Bytes requested to the system
+};
 
-//Acts as a pop
-int pop(node *head){
-    node temp = *head;
+//The pools serve the linked list nodes, the released nodes are kept in a free list and reused
+struct pool{
+    struct arena arena;
+    node free_list;
+    int live; //Number of nodes currently in use
+    int peak;
+};
 
-    if(*head == NULL) return 0; //If the stack is already empty, so there's nothing to remove
+struct arena program_arena = {.name = "program"};
+struct arena string_arena = {.name = "strings"};
+struct arena stack_arena = {.name = "stack"};
+struct pool var_pool = {.arena = {.name = "variables"}};
+int stack_peak = 0; //The deepest stack reached by the run
 
-    if((*head)->next == NULL){ //If there's only one element, it gets deleted and then the head is set to NULL
-        node temp = *head;
-        *head = temp->next;
-        free(temp);
-        return 1;
+void *arena_alloc(struct arena *a, size_t size){
+    struct chunk *c = a->head;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if(c == NULL || c->used + size > c->size){ //If the current chunk is full a new one is requested
+        size_t chunk_size = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+
+        c = malloc(sizeof(struct chunk) + chunk_size);
+        if(c == NULL){
+            printf("ERROR 11: Out of memory\n");
+            exit(11);
+        }
+        c->size = chunk_size;
+        c->used = 0;
+        c->next = a->head;
+        a->head = c;
+        a->reserved += sizeof(struct chunk) + chunk_size;
     }
 
-    while(temp->next->next != NULL) temp = temp->next; //Stops at the second to last element
-    node n = temp->next; //Saves the last node in the stack
-    temp->next = n->next; //Disconnects the last element from the stack
-    free(n); //Removes it
-    return 1;
+    void *p = c->data + c->used;
+    c->used += size;
+    a->allocated += size;
+
+    return p;
 }
 
-int dup(node head){
-    if(head == NULL) return 0;
+void arena_reset(struct arena *a){ //Gives back all the chunks, the cost depends only on the number of chunks
+    struct chunk *c = a->head;
 
-    while(head->next != NULL) head = head->next; //Stops at the top element
+    while(c != NULL){
+        struct chunk *n = c->next;
+        free(c);
+        c = n;
+    }
+    a->head = NULL;
+    a->allocated = 0;
+    a->reserved = 0;
+}
 
-    //Creates and inserts the duplicated node between the top and the null one
-    node n = new_node();
-    n->value = head->value;
-    n->next = head->next;
-    head->next = n;
+char *pool_string(char string[]){ //Copies the string inside the string pool
+    size_t len = strlen(string) + 1;
+    char *s = arena_alloc(&string_arena, len);
 
-    return 1;
+    memcpy(s, string, len);
+    return s;
 }
 
-void clear(node *head){
-    while(*head != NULL) pop(head);
-}
+node new_node(struct pool *p){
+    node n = p->free_list;
 
-int swap(node *head){
-    int swap; //Serves as a support for the value's switch
-    node temp = *head;
+    if(n != NULL) p->free_list = n->next; //Reuses a released node if possible
+    else n = arena_alloc(&p->arena, sizeof(l));
 
-    if(*head == NULL || (*head)->next == NULL) return 0; //If the stack is not composed of at least two elements the function returns 0
+    if(++p->live > p->peak) p->peak = p->live;
+    return n;
+}
 
-    while(temp->next->next) temp = temp->next; //Stops at the second to last element
+void free_node(struct pool *p, node n){
+    n->next = p->free_list;
+    p->free_list = n;
+    p->live--;
+}
 
-    //Swaps the elements' values
-    swap = temp->value;
-    temp->value = temp->next->value;
-    temp->next->value = swap;
+void pool_reset(struct pool *p){
+    arena_reset(&p->arena);
+    p->free_list = NULL;
+    p->live = 0;
+}
 
-    return 1;
+void print_mem_stats(){
+    struct arena *arenas[] = {&program_arena, &string_arena, &stack_arena, &var_pool.arena};
+
+    fflush(stdout); //Keeps the report after the program output
+    fprintf(stderr, "\nMEMORY STATS\n");
+    fprintf(stderr, "peak stack depth: %d\n", stack_peak);
+    fprintf(stderr, "peak variable count: %d\n", var_pool.peak);
+    for(int i = 0; i < 4; i++)
+        fprintf(stderr, "arena %-10s %zu bytes allocated, %zu bytes reserved\n", arenas[i]->name, arenas[i]->allocated, arenas[i]->reserved);
 }
 
-int sum(node *head){
-    node temp = *head;
+//################################# - end of the section - #################################################
+
+#define STACK_START 64 //Defines the initial capacity of a stack
 
-    if(*head == NULL || (*head)->next == NULL) return 0; //If the stack is not composed of at least two elements the function returns 0
+void grow(struct stack *s){ //Doubles the capacity, the old array stays in the arena until the end of the run
+    int capacity = s->capacity ? s->capacity * 2 : STACK_START;
+    float *values = arena_alloc(&stack_arena, capacity * sizeof(float));
 
-    while(temp->next->next) temp = temp->next; //Stops at the second to last element
+    if(s->size > 0) memcpy(values, s->values, s->size * sizeof(float));
+    s->values = values;
+    s->capacity = capacity;
+}
 
-    temp->value = temp->value + temp->next->value; //Sums the two values
+//Serves as a push
+void push(struct stack *s, float v){
+    if(s->size == s->capacity) grow(s);
+    s->values[s->size++] = v;
+    if(s->size > stack_peak) stack_peak = s->size;
+}
 
-    node n = temp->next; //Store the node to delete
-    temp->next = temp->next->next; //Removes the n node
-    free(n); //Deletes the node
+//Acts as a pop
+int pop(struct stack *s){
+    if(s->size == 0) return 0; //If the stack is already empty, so there's nothing to remove
 
+    s->size--;
     return 1;
 }
 
-int sub(node *head){
-    node temp = *head;
+void clear(struct stack *s){
+    s->size = 0;
+}
 
-    if(*head == NULL || (*head)->next == NULL) return 0; 
+/*The elements are reached by their distance from the top, 0 is the top itself. dup is pick 0, over is pick 1,
+swap is roll 1 and rot is roll 2*/
+int pick(struct stack *s, float n){ //Copies on top the element at distance n
+    float v;
 
-    while(temp->next->next) temp = temp->next; 
+    if(!(n >= 0 && n < s->size)) return 0; //Written so that a NaN fails it too
+
+    v = s->values[s->size - 1 - (int)n];
+    push(s, v);
+    return 1;
+}
 
-    temp->value = temp->value - temp->next->value;
+int roll(struct stack *s, float n){ //Moves on top the element at distance n, the ones above it go down by one
+    int k;
+    float v;
 
-    node n = temp->next; 
-    temp->next = temp->next->next; 
-    free(n); 
+    if(!(n >= 0 && n < s->size)) return 0;
 
+    k = n;
+    v = s->values[s->size - 1 - k];
+    memmove(&s->values[s->size - 1 - k], &s->values[s->size - k], k * sizeof(float));
+    s->values[s->size - 1] = v;
     return 1;
 }
 
-int mult(node *head){
-    node temp = *head;
+int drop(struct stack *s, float n){ //Removes the top n elements
+    if(!(n >= 0 && n <= s->size)) return 0;
 
-    if(*head == NULL || (*head)->next == NULL) return 0;
+    s->size -= (int)n;
+    return 1;
+}
 
-    while(temp->next->next) temp = temp->next;
+int sum(struct stack *s){
+    if(s->size < 2) return 0; //If the stack is not composed of at least two elements the function returns 0
 
-    temp->value = temp->value * temp->next->value;
+    s->values[s->size - 2] = s->values[s->size - 2] + s->values[s->size - 1]; //Sums the two values
+    s->size--;
 
-    node n = temp->next;
-    temp->next = temp->next->next;
-    free(n);
-    
     return 1;
 }
 
-int my_div(node *head){ //Called like this to avoid conflicts with the C function div
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return 0;
+int sub(struct stack *s){
+    if(s->size < 2) return 0;
 
-    while(temp->next->next) temp = temp->next;
+    s->values[s->size - 2] = s->values[s->size - 2] - s->values[s->size - 1];
+    s->size--;
 
-    if(temp->next->value == 0) return 0; //You can't divide a number by 0
+    return 1;
+}
 
-    temp->value = temp->value / temp->next->value;
+int mult(struct stack *s){
+    if(s->size < 2) return 0;
 
-    node n = temp->next;
-    temp->next = temp->next->next;
-    free(n);
+    s->values[s->size - 2] = s->values[s->size - 2] * s->values[s->size - 1];
+    s->size--;
 
     return 1;
 }
 
-int rem(node *head){
-    int first, second;
-    node temp = *head;
+int my_div(struct stack *s){ //Called like this to avoid conflicts with the C function div
+    if(s->size < 2) return 0;
+    if(s->values[s->size - 1] == 0) return 0; //You can't divide a number by 0
 
-    if(*head == NULL || (*head)->next == NULL) return 0;
+    s->values[s->size - 2] = s->values[s->size - 2] / s->values[s->size - 1];
+    s->size--;
 
-    while(temp->next->next) temp = temp->next;
+    return 1;
+}
 
-    if(temp->next->value == 0) return 0; //You can't divide a number by 0
+int rem(struct stack *s){
+    int first, second;
 
-    first = temp->value;
-    second = temp->next->value;
+    if(s->size < 2) return 0;
+    if(s->values[s->size - 1] == 0) return 0; //You can't divide a number by 0
 
-    temp->value = first % second;
+    first = s->values[s->size - 2];
+    second = s->values[s->size - 1];
 
-    node n = temp->next;
-    temp->next = temp->next->next;
-    free(n);
+    s->values[s->size - 2] = first % second;
+    s->size--;
 
     return 1;
 }
 
-int toint(node head){ //Lowers down the number value
+int toint(struct stack *s){ //Lowers down the number value
     int intvalue;
 
-    if(head == NULL) return 0;
+    if(s->size == 0) return 0;
 
-    while(head->next != NULL) head = head->next;
-
-    intvalue = head->value;
-    head->value = intvalue;
+    intvalue = s->values[s->size - 1];
+    s->values[s->size - 1] = intvalue;
 
     return 1;
 }
 
-int inc(node head){
-    if(head == NULL) return 0;
+int inc(struct stack *s){
+    if(s->size == 0) return 0;
 
-    while(head->next != NULL) head = head->next;
-    head->value = head->value + 1;
+    s->values[s->size - 1] = s->values[s->size - 1] + 1;
 
     return 1;
 }
 
-int dec(node head){
-    if(head == NULL) return 0;
+int dec(struct stack *s){
+    if(s->size == 0) return 0;
 
-    while(head->next != NULL) head = head->next;
-    head->value = head->value - 1;
+    s->values[s->size - 1] = s->values[s->size - 1] - 1;
 
     return 1;
 }
@@ -319,107 +519,77 @@ int dec(node head){
 //################################# - binary operations - ##################################################
 
 
-int and(node *head){
+int and(struct stack *s){
     int first, second;
-    node temp = *head;
 
-    if(*head == NULL || (*head)->next == NULL) return 0; 
+    if(s->size < 2) return 0;
 
-    while(temp->next->next) temp = temp->next; 
+    first = s->values[s->size - 2];
+    second = s->values[s->size - 1];
 
-    first = temp->value;
-    second = temp->next->value;
-
-    temp->value = first & second;
-
-    node n = temp->next; 
-    temp->next = temp->next->next; 
-    free(n); 
+    s->values[s->size - 2] = first & second;
+    s->size--;
 
     return 1;
 }
 
-int or(node *head){
+int or(struct stack *s){
     int first, second;
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return 0; 
 
-    while(temp->next->next) temp = temp->next;
+    if(s->size < 2) return 0;
 
-    first = temp->value;
-    second = temp->next->value;
+    first = s->values[s->size - 2];
+    second = s->values[s->size - 1];
 
-    temp->value = first | second;
-
-    node n = temp->next; 
-    temp->next = temp->next->next; 
-    free(n); 
+    s->values[s->size - 2] = first | second;
+    s->size--;
 
     return 1;
 }
 
-int xor(node *head){
+int xor(struct stack *s){
     int first, second;
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return 0; 
-
-    while(temp->next->next) temp = temp->next;
 
-    first = temp->value;
-    second = temp->next->value;
+    if(s->size < 2) return 0;
 
-    temp->value = first ^ second;
+    first = s->values[s->size - 2];
+    second = s->values[s->size - 1];
 
-    node n = temp->next; 
-    temp->next = temp->next->next; 
-    free(n); 
+    s->values[s->size - 2] = first ^ second;
+    s->size--;
 
     return 1;
 }
 
-int not(node *head){
+int not(struct stack *s){
     int first;
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return 0; 
 
-    while(temp->next) temp = temp->next; //Stops at the last element
+    if(s->size < 2) return 0;
 
-    first = temp->value;
-
-    temp->value = ~first;
+    first = s->values[s->size - 1];
+    s->values[s->size - 1] = ~first;
 
     return 1;
 }
 
-int lshift(node *head){
+int lshift(struct stack *s){
     int first;
-    node temp = *head;
 
-    if(*head == NULL || (*head)->next == NULL) return 0; 
+    if(s->size < 2) return 0;
 
-    while(temp->next) temp = temp->next;
-
-    first = temp->value;
-
-    temp->value = first << 1;
+    first = s->values[s->size - 1];
+    s->values[s->size - 1] = first << 1;
 
     return 1;
 }
 
-int rshift(node *head){
+int rshift(struct stack *s){
     int first;
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return 0;
 
-    while(temp->next) temp = temp->next;
+    if(s->size < 2) return 0;
 
-    first = temp->value;
-
-    temp->value = first >> 1;
+    first = s->values[s->size - 1];
+    s->values[s->size - 1] = first >> 1;
 
     return 1;
 }
@@ -452,70 +622,46 @@ int next_valid_instruction(token code[], int elements, int current_pos){ //It re
     return 0;
 }
 
-int if_eq(node *head){
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return -1; /*The functions returns -1 to communicate
-                                                           that an error is occuring because the elements on the stack are insufficient*/
-
-    while(temp->next->next) temp = temp->next;
+int if_eq(struct stack *s){
+    if(s->size < 2) return -1; /*The functions returns -1 to communicate
+                                  that an error is occuring because the elements on the stack are insufficient*/
 
-    if(temp->next->value == temp->value) return 1;
+    if(s->values[s->size - 1] == s->values[s->size - 2]) return 1;
     return 0;
 }
 
-int if_dif(node *head){
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return -1;
+int if_dif(struct stack *s){
+    if(s->size < 2) return -1;
 
-    while(temp->next->next) temp = temp->next;
-
-    if(temp->next->value != temp->value) return 1;
+    if(s->values[s->size - 1] != s->values[s->size - 2]) return 1;
     return 0;
 }
 
-int if_gr(node *head){
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return -1;
-
-    while(temp->next->next) temp = temp->next;
+int if_gr(struct stack *s){
+    if(s->size < 2) return -1;
 
-    if(temp->value > temp->next->value) return 1;
+    if(s->values[s->size - 2] > s->values[s->size - 1]) return 1;
     return 0;
 }
 
-int if_lw(node *head){
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return -1;
+int if_lw(struct stack *s){
+    if(s->size < 2) return -1;
 
-    while(temp->next->next) temp = temp->next;
-
-    if(temp->value < temp->next->value) return 1;
+    if(s->values[s->size - 2] < s->values[s->size - 1]) return 1;
     return 0;
 }
 
-int if_true(node *head){
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return -1;
-
-    while(temp->next) temp = temp->next;
+int if_true(struct stack *s){
+    if(s->size == 0) return -1;
 
-    if(temp->next->value == 1) return 1;
+    if(s->values[s->size - 1] == 1) return 1;
     return 0;
 }
 
-int if_false(node *head){
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return -1;
+int if_false(struct stack *s){
+    if(s->size == 0) return -1;
 
-    while(temp->next) temp = temp->next;
-
-    if(temp->next->value == 0) return 1;
+    if(s->values[s->size - 1] == 0) return 1;
     return 0;
 }
 
@@ -535,36 +681,94 @@ void prepare_string(char string[], int l, char temp[]){
     temp[i] = '\0';
 }
 
-int out(node head, int code){
-    int c;
+/*The values are formatted without printf: the float is split into its integer mantissa and its exponent, so the
+value multiplied by 1000 is computed exactly with integers and rounded like printf does (to the nearest, ties to
+even). The text is the same of %.3f and %d, the values too big for the integers and inf and nan use printf*/
+int format_unsigned(unsigned long long u, char buf[]){ //Writes u in buf and returns the length
+    char digits[24];
+    int l = 0, n = 0;
+
+    do{
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+    }while(u != 0);
+
+    while(n > 0) buf[l++] = digits[--n];
+    buf[l] = '\0';
+    return l;
+}
+
+int format_int(int v, char buf[]){
+    if(v >= 0) return format_unsigned(v, buf);
+
+    buf[0] = '-';
+    return format_unsigned(-(unsigned long long)v, buf + 1) + 1;
+}
+
+int format_float(float v, char buf[]){ //Writes v with 3 decimals in buf and returns the length
+    unsigned int bits;
+    unsigned long long mantissa, thousandths;
+    int exponent, l = 0;
+
+    memcpy(&bits, &v, sizeof(bits));
+    exponent = (bits >> 23) & 0xff;
+    mantissa = bits & 0x7fffff;
+
+    if(exponent == 0xff || exponent > 127 + 23 + 30) return sprintf(buf, "%.3f", v); //inf, nan and values over 2^54
+    if(exponent == 0) exponent = 1; //Denormalized number
+    else mantissa |= 0x800000;
+    exponent -= 127 + 23; //v = mantissa * 2^exponent
+
+    if(exponent >= 0)
+        thousandths = (mantissa << exponent) * 1000;
+    else if(exponent < -63) //v * 1000 is lower than 0.5
+        thousandths = 0;
+    else{
+        unsigned long long scaled = mantissa * 1000;
+        unsigned long long rest = scaled & ((1ULL << -exponent) - 1), half = 1ULL << (-exponent - 1);
+
+        thousandths = scaled >> -exponent;
+        if(rest > half || (rest == half && (thousandths & 1))) thousandths++;
+    }
+
+    if(bits >> 31) buf[l++] = '-'; //printf keeps the sign of the negative numbers rounded to zero
+    l += format_unsigned(thousandths / 1000, buf + l);
+    buf[l++] = '.';
+    buf[l++] = '0' + thousandths / 100 % 10;
+    buf[l++] = '0' + thousandths / 10 % 10;
+    buf[l++] = '0' + thousandths % 10;
+    buf[l] = '\0';
+    return l;
+}
 
-    if(head == NULL) return 0; //If the stack is empty the function fails
+int out(struct stack *s, int code){
+    int c;
+    char buf[64];
 
-    while(head->next != NULL) head = head->next;
+    if(s->size == 0) return 0; //If the stack is empty the function fails
 
     switch (code)
     {
     case 0: //Prints as a float
-        printf("%.3f", head->value);
+        output_bytes += fwrite(buf, 1, format_float(s->values[s->size - 1], buf), stdout);
         break;
     case 1: //Prints as an integer
-        c = head->value;
-        printf("%d", c);
+        c = s->values[s->size - 1];
+        output_bytes += fwrite(buf, 1, format_int(c, buf), stdout);
         break;
     case 2: //Prints as a char
-        c = head->value;
-        printf("%c", c);
+        c = s->values[s->size - 1];
+        output_bytes += printf("%c", c);
         break;
     }
 
     return 1;
 }
 
-void in(node *head, int code){
+int in(struct stack *s, int code){ //Returns 0 if the input ends or the watchdog stops it
     float input;
     char c, character;
-    int valid;
-    node temp = *head;
+    int valid, empty = s->size == 0;
 
     while(1){//Keeps asking for a value if the given one is not correct
 
@@ -577,23 +781,14 @@ void in(node *head, int code){
         }
 
         if(valid == 1) break; //If the input is valid the loop ends to continue the function
+        if(valid == EOF || expired) return 0; //The watchdog stops the endless requests of a wrong input
     }
     
-    node n = new_node();
-    n->value = input;
-    
-
-    if(*head == NULL){ //If the stack is empty, the node is inserted berfore the null node
-        n->next = *head;
-        *head = n;
-        return;
-    }
-
-    while(temp->next != NULL) temp = temp->next; //Stops at the last non null element
-    n->next = temp->next; //Connects the new element to the null one
-    temp->next = n; //Connects the new element to the last non null element
+    push(s, input);
+    if(empty) return 1; //The input buffer is kept when the stack was empty
 
     while((c = getchar()) != '\n' && c != EOF); //Clears the input buffer
+    return 1;
 }
 
 void sclear(){
@@ -625,13 +820,29 @@ int jump(token code[], int elements, char label[D]){ //Jumps to the given label
 
 //################################# - Variables section - #################################################
 
-int store(node varstack, node stack, char name[]){ //Loads the variable content on top of the stack
+node new_var(node *head, char name[]){ //Adds the variable at the end of the list
+    node temp = *head;
+
+    node new = new_node(&var_pool);
+    new->value = 0; //Sets the default variable value to 0
+    strncpy(new->name, name, NAME_SIZE);
+    new->next = NULL;
+    if(temp == NULL){ //If there are no variables
+        *head = new;
+        return new;
+    }
+
+    while(temp->next != NULL) temp = temp->next; //Stops at the last variable
+    temp->next = new;
+    return new;
+}
+
+int store(node varstack, struct stack *stack, char name[]){ //Loads the variable content on top of the stack
     if(varstack == NULL) return 0; //If the variable stack is empty
 
     while(varstack != NULL){
         if(strncmp(varstack->name, name, NAME_SIZE) == 0){
-            while(stack->next != NULL) stack = stack->next;
-            varstack->value = stack->value;
+            varstack->value = stack->values[stack->size - 1];
             return 1;
         }
         varstack = varstack->next;
@@ -640,12 +851,12 @@ int store(node varstack, node stack, char name[]){ //Loads the variable content
     return 0;
 }
 
-int load(node varstack, node *stack, char name[]){ //Loads the variable content on top of the stack
+int load(node varstack, struct stack *stack, char name[]){ //Loads the variable content on top of the stack
     if(varstack == NULL) return 0; //If the variable stack is empty
 
     while(varstack != NULL){
         if(strncmp(varstack->name, name, NAME_SIZE) == 0){
-            push(stack, varstack->value, "");
+            push(stack, varstack->value);
             return 1;
         }
         varstack = varstack->next;
@@ -654,6 +865,14 @@ int load(node varstack, node *stack, char name[]){ //Loads the variable content
     return 0;
 }
 
+unsigned int var_generation = 0; //Changes when a variable is deleted, so the loads remembered by the optimizer search again
+
+node find_var(node varstack, char name[]){ //The first variable with the given name, NULL if it doesn't exist
+    for(; varstack != NULL; varstack = varstack->next)
+        if(strncmp(varstack->name, name, NAME_SIZE) == 0) return varstack;
+    return NULL;
+}
+
 int delete_var(node *varstack, char name[]){ //Deletes the variable with the specified name
     node temp = *varstack;
 
@@ -661,7 +880,8 @@ int delete_var(node *varstack, char name[]){ //Deletes the variable with the spe
 
     if(strncmp((*varstack)->name, name, NAME_SIZE) == 0){ //Checks if the variable to delete is the first one
         *varstack = temp->next;
-        free(temp);
+        free_node(&var_pool, temp);
+        var_generation++;
         return 1;
     }
 
@@ -669,7 +889,8 @@ int delete_var(node *varstack, char name[]){ //Deletes the variable with the spe
         if(strncmp(temp->next->name, name, NAME_SIZE) == 0){
             node n = temp->next;
             temp->next = n->next;
-            free(n);
+            free_node(&var_pool, n);
+            var_generation++;
             return 1;
         }
         temp = temp->next;
@@ -683,125 +904,83 @@ int delete_var(node *varstack, char name[]){ //Deletes the variable with the spe
 
 //################################# - Advanced math section - ##############################################
 
-int my_abs(node *stack){ //I decided to avoid using the library for this simple function
-    node temp = *stack;
+int my_abs(struct stack *s){ //I decided to avoid using the library for this simple function
+    if(s->size == 0) return 0; //Checks if the stack is empty
 
-    if(*stack == NULL) return 0; //Checks if the stack is empty
-    while(temp->next != NULL) temp = temp->next;
-    
-    if(temp->value < 0) temp->value *= (-1);
+    if(s->values[s->size - 1] < 0) s->values[s->size - 1] *= (-1);
 
     return 1;
 }
 
-int my_pow(node *head){
-    node temp = *head;
-
-    if(*head == NULL || (*head)->next == NULL) return 0; 
-
-    while(temp->next->next) temp = temp->next;
+int my_pow(struct stack *s){
+    if(s->size < 2) return 0;
 
-    temp->value = powf(temp->value, temp->next->value);
-
-    node n = temp->next; 
-    temp->next = temp->next->next; 
-    free(n); 
+    s->values[s->size - 2] = powf(s->values[s->size - 2], s->values[s->size - 1]);
+    s->size--;
 
     return 1;
 }
 
-int ln(node *head){
-    node temp = *head;
-
-    if(*head == NULL) return 0; 
-
-    while(temp->next) temp = temp->next;
+int ln(struct stack *s){
+    if(s->size == 0) return 0;
 
-    temp->value = logf(temp->value);
+    s->values[s->size - 1] = logf(s->values[s->size - 1]);
 
     return 1;
 }
 
-int my_log(node *head){
-    node temp = *head;
-
-    if(*head == NULL) return 0; 
+int my_log(struct stack *s){
+    if(s->size == 0) return 0;
 
-    while(temp->next) temp = temp->next;
-
-    temp->value = log10f(temp->value);
+    s->values[s->size - 1] = log10f(s->values[s->size - 1]);
 
     return 1;
 }
 
-int logtw(node *head){
-    node temp = *head;
-
-    if(*head == NULL) return 0; 
-
-    while(temp->next) temp = temp->next;
+int logtw(struct stack *s){
+    if(s->size == 0) return 0;
 
-    temp->value = log2f(temp->value);
+    s->values[s->size - 1] = log2f(s->values[s->size - 1]);
 
     return 1;
 }
 
-int my_ceil(node *head){
-    node temp = *head;
-
-    if(*head == NULL) return 0; 
+int my_ceil(struct stack *s){
+    if(s->size == 0) return 0;
 
-    while(temp->next) temp = temp->next;
-
-    temp->value = ceilf(temp->value);
+    s->values[s->size - 1] = ceilf(s->values[s->size - 1]);
 
     return 1;
 }
 
-int my_sqrt(node *head){
-    node temp = *head;
-
-    if(*head == NULL) return 0; 
-
-    while(temp->next) temp = temp->next;
+int my_sqrt(struct stack *s){
+    if(s->size == 0) return 0;
 
-    temp->value = sqrtf(temp->value);
+    s->values[s->size - 1] = sqrtf(s->values[s->size - 1]);
 
     return 1;
 }
 
-int my_sin(node *head){
-    node temp = *head;
-
-    if(*head == NULL) return 0; 
+int my_sin(struct stack *s){
+    if(s->size == 0) return 0;
 
-    while(temp->next) temp = temp->next;
-
-    temp->value = sinf(temp->value);
+    s->values[s->size - 1] = sinf(s->values[s->size - 1]);
 
     return 1;
 }
 
-int my_cos(node *head){
-    node temp = *head;
-
-    if(*head == NULL) return 0; 
-
-    while(temp->next) temp = temp->next;
+int my_cos(struct stack *s){
+    if(s->size == 0) return 0;
 
-    temp->value = cosf(temp->value);
+    s->values[s->size - 1] = cosf(s->values[s->size - 1]);
 
     return 1;
 }
 
-int my_tan(node *head){
-    node temp = *head;
-
-    if(*head == NULL) return 0; 
+int my_tan(struct stack *s){
+    if(s->size == 0) return 0;
 
-    while(temp->next) temp = temp->next;
-
-    temp->value = tanf(temp->value);
+    s->values[s->size - 1] = tanf(s->values[s->size - 1]);
 
     return 1;
 }
@@ -812,682 +991,4488 @@ int my_tan(node *head){
 
 //################################# - Random section - #####################################################
 
-void randint(node *head, float n){
+void randint(struct stack *s, float n, unsigned int seed){
     float number;
     int limit = n;
 
-    srand(time(0));
+    srand(seed);
     number = (rand() % limit) + 1;
-    push(head, number, "");
+    push(s, number);
 }
 
 //################################# - end of the section - #################################################
 
+//################################# - Sorting section - ####################################################
 
-void printlist(node head){
-    if(head == NULL){
-        printf("\nEMPTY\n");
-        return;
-    }
+#define SORT_ASCENDING 0
+#define SORT_DESCENDING 1
+#define SORT_UNIQUE 2
 
-    printf("\n|");
-    for(;head != NULL; head = head->next) printf("%.3f|", head->value);
-    printf("<-top\n");
+#define RADIX_MIN 256 //Below this number of elements the introsort is faster than the four passes of the radix sort
+#define INSERTION_MAX 16
+
+/*The values are sorted as keys: the bits of a float, with the sign bit flipped for the positive numbers and every bit
+flipped for the negative ones, compare as unsigned integers in the same order of the floats. The keys turn back into
+the same floats, so the sort never changes a value*/
+struct{
+    unsigned int *keys;
+    unsigned int *temp;
+    int size;
+}sorting;
+
+unsigned int float_key(float v){
+    unsigned int k;
+
+    memcpy(&k, &v, sizeof(k));
+    return k & 0x80000000u ? ~k : k | 0x80000000u;
 }
 
-/*This function is a secure version of fscanf that truncates the string by the length of the given string. This approach serves to avoid buffer overflow*/
-int sfscanf(FILE *fp, char string[], int l, int *line, char *carriage){
-    char c;
-    int is_string = 0;
-    int i = 0;
+float key_float(unsigned int k){
+    float v;
 
-    if(fp == NULL || string == NULL || l <= 0) return EOF;
+    k = k & 0x80000000u ? k & 0x7fffffffu : ~k;
+    memcpy(&v, &k, sizeof(v));
+    return v;
+}
 
-    if(*carriage == '\n') (*line)++; //Is necessary to avoid missing a \n character
+void insertion_sort(unsigned int a[], int n){
+    for(int i = 1; i < n; i++){
+        unsigned int k = a[i];
+        int j;
 
-    /*Scrolls the contents of the file until the character c is a valid character. This cycle is important because it skips all the indentation
-    and space charaters, leaving only the right characters*/
-    while((c = fgetc(fp)) != EOF && isspace(c)){
-        if(c == '\n'){
-            (*line)++;
-        }
+        for(j = i; j > 0 && a[j - 1] > k; j--) a[j] = a[j - 1];
+        a[j] = k;
     }
+}
 
-    if(c == EOF){ //Covers the case where in the file there's nothing valid. For example the last portion of the file could only consist in space characters
-        string[0] = '\0';
-        return EOF;
+void sift_down(unsigned int a[], int root, int n){
+    unsigned int k = a[root];
+    int child;
+
+    while((child = 2 * root + 1) < n){
+        if(child + 1 < n && a[child + 1] > a[child]) child++;
+        if(a[child] <= k) break;
+        a[root] = a[child];
+        root = child;
     }
+    a[root] = k;
+}
 
-    
-    if(c == '\"') is_string = 1;//Avoid the first character because it is the beginnning of a string
-    string[i++] = c; //This line of code is necesarry to avoid skipping the first charcter of the string which is a valid one
+void heap_sort(unsigned int a[], int n){
+    for(int i = n / 2 - 1; i >= 0; i--) sift_down(a, i, n);
+    for(int i = n - 1; i > 0; i--){
+        unsigned int k = a[0];
 
-    while((c = fgetc(fp)) != EOF && i < l - 1){ //Loads the string if the character c or the length are valid
-        if(is_string){
-            string[i++] = c;
-            if(c == '\"') break;
+        a[0] = a[i];
+        a[i] = k;
+        sift_down(a, 0, i);
+    }
+}
+
+void intro_sort(unsigned int a[], int n, int depth){ //Quicksort that switches to the heapsort when it goes too deep
+    while(n > INSERTION_MAX){
+        unsigned int k, pivot;
+        int mid = n / 2, l = -1, r = n;
+
+        if(depth-- == 0){
+            heap_sort(a, n);
+            return;
+        }
+
+        //The median of the first, middle and last keys is moved in the middle
+        if(a[mid] < a[0]){ k = a[mid]; a[mid] = a[0]; a[0] = k; }
+        if(a[n - 1] < a[mid]){ k = a[n - 1]; a[n - 1] = a[mid]; a[mid] = k; }
+        if(a[mid] < a[0]){ k = a[mid]; a[mid] = a[0]; a[0] = k; }
+        pivot = a[mid];
+
+        while(1){
+            while(a[++l] < pivot);
+            while(a[--r] > pivot);
+            if(l >= r) break;
+            k = a[l];
+            a[l] = a[r];
+            a[r] = k;
+        }
+
+        if(r + 1 < n - r - 1){ //The smaller part is sorted by the recursion, the larger one by the loop
+            intro_sort(a, r + 1, depth);
+            a += r + 1;
+            n -= r + 1;
         }
         else{
-            if(isspace(c)){
-                if(c == '\n'){
-                    (*carriage) = '\n';
-                    
-                }
-                break;
-            }
-            else{
-                string[i++] = c;
-                (*carriage) = '\0';
-            }
+            intro_sort(a + r + 1, n - r - 1, depth);
+            n = r + 1;
         }
-        
     }
 
-    string[i] = '\0'; //Terminates the string
-
-    return 1;
+    insertion_sort(a, n);
 }
 
+void radix_sort(unsigned int a[], unsigned int temp[], int n){ //LSD radix sort on bytes, the result is left in a
+    int count[4][257];
+    unsigned int *from = a, *to = temp, *t;
 
-int real_number(char s[]){ //Checks if the given number is a float
-    for(int i = 0; s[i] != '\0'; i++)
-        if((isalpha(s[i]) || ispunct(s[i])) && s[i] != '.' && s[i] != '-')
-            return 0;
-    
-    return 1;
-}
+    memset(count, 0, sizeof(count));
+    for(int i = 0; i < n; i++) //The histograms of the four bytes are counted together
+        for(int b = 0; b < 4; b++) count[b][((a[i] >> (8 * b)) & 255) + 1]++;
 
-int initial_debug(token code[], int elements){ //Checks if the if are declared correctly
-    int if_stack[elements];
-    int endif_stack[elements];
+    for(int b = 0; b < 4; b++){
+        int shift = 8 * b;
 
-    int if_top = 0;
-    for(int i = 0; i < elements; i++){
-        if(strncmp(code[i].string, "ifeq", D) == 0 || strncmp(code[i].string, "ifdif", D) == 0 || strncmp(code[i].string, "ifgr", D) == 0 || strncmp(code[i].string, "iflw", D) == 0 || strncmp(code[i].string, "iftrue", D) == 0 || strncmp(code[i].string, "iffalse", D) == 0){
-            if_stack[if_top++] = code[i].line;
-        }
-        if(strncmp(code[i].string, "endif", D) == 0 && if_top >= 0){
-            if_top--;
-        }
+        if(count[b][((a[0] >> shift) & 255) + 1] == n) continue; //Every key has the same byte
+        for(int d = 0; d < 256; d++) count[b][d + 1] += count[b][d];
+        for(int i = 0; i < n; i++) to[count[b][(from[i] >> shift) & 255]++] = from[i];
+        t = from;
+        from = to;
+        to = t;
     }
-    int endif_top = 0;
-    for(int i = elements; i > 0; i--){ //The tokens are scrolled from the end to obtain the same result as for the if cycles
-        if(strncmp(code[i].string, "endif", D) == 0){
-            endif_stack[endif_top++] = code[i].line;
-        }
 
-        if((strncmp(code[i].string, "ifeq", D) == 0 || strncmp(code[i].string, "ifdif", D) == 0 || strncmp(code[i].string, "ifgr", D) == 0 || strncmp(code[i].string, "iflw", D) == 0 || strncmp(code[i].string, "iftrue", D) == 0 || strncmp(code[i].string, "iffalse", D) == 0) && endif_top > -1){
-            endif_top--;
+    if(from != a) memcpy(a, from, n * sizeof(unsigned int));
+}
+
+int sort(struct stack *s, int n, int mode){ //Sorts the top n elements, or the whole stack when n is -1. Returns 0 if the stack is too small
+    int depth = 0, kept;
+    float *values;
+
+    if(n == -1) n = s->size;
+    if(n > s->size) return 0;
+    if(n < 2) return 1;
+
+    if(n > sorting.size){
+        sorting.size = n;
+        sorting.keys = realloc(sorting.keys, n * sizeof(unsigned int));
+        sorting.temp = realloc(sorting.temp, n * sizeof(unsigned int));
+        if(sorting.keys == NULL || sorting.temp == NULL){
+            printf("ERROR 11: Out of memory\n");
+            exit(11);
         }
     }
 
-    for(int i = 0; i < if_top; i++){
-        printf("ERROR 9: The if at line %d is missing its counter part\n", if_stack[i]);
+    values = s->values + s->size - n; //The first of the elements to sort
+    for(int k = 0; k < n; k++) sorting.keys[k] = float_key(values[k]);
+
+    if(n >= RADIX_MIN)
+        radix_sort(sorting.keys, sorting.temp, n);
+    else{
+        for(int m = n; m > 1; m >>= 1) depth += 2;
+        intro_sort(sorting.keys, n, depth);
     }
 
-    for(int i = endif_top - 1; i >= 0; i--){ //To print the errors in the correct order it's necessary to navigate the endif_stack backwards
-        printf("ERROR 9: The endif at line %d is missing its counter part\n", endif_stack[i]);
+    kept = n;
+    if(mode == SORT_UNIQUE){
+        kept = 1;
+        for(int k = 1; k < n; k++)
+            if(sorting.keys[k] != sorting.keys[kept - 1]) sorting.keys[kept++] = sorting.keys[k];
     }
 
-    if(if_top < 0 || endif_top < 0) return 0;
+    for(int k = 0; k < kept; k++) values[k] = key_float(sorting.keys[mode == SORT_DESCENDING ? n - 1 - k : k]);
+    s->size -= n - kept; //The duplicates removed by the unique sort
+
     return 1;
 }
 
-int valid_extension(char filename[]){ //Checks if the file extension is valid
-    char extension[5];
+//################################# - end of the section - #################################################
 
-    int len = strlen(filename);
-    if(len <= 4) return 0;
+//################################# - Profiling section - ##################################################
 
-    int j = 0;
-    for(int i = len - 4; i < len; i++)
-        extension[j++] = filename[i];
-    extension[j] = '\0';
+struct{
+    long *count; //Number of executions of each token
+    long long *ns; //Time spent on each token
+    long *entries; //Number of times the code after each label has been reached
+    int *label; //For every token contains the index of the label that precedes it, -1 otherwise
+    int last; //Token being timed
+    long long start;
+}profile;
 
-    if(strncmp(extension, ".fsn", 5) == 0) return 1;
+long long now_ns(){
+    struct timespec ts;
 
-    return 0; 
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
-int main(int argc, char *argv[])
-{
-    FILE *fp;
-    char line[D], carriage;
-    int elements = 0, pos = 0;
-
-    node stack = NULL; //Creates the head of the stack
-    node varstack = NULL; //Creates the head of the varstack
+void profile_init(token code[], int elements){
+    profile.count = arena_alloc(&program_arena, elements * sizeof(long));
+    profile.ns = arena_alloc(&program_arena, elements * sizeof(long long));
+    profile.entries = arena_alloc(&program_arena, elements * sizeof(long));
+    profile.label = arena_alloc(&program_arena, elements * sizeof(int));
 
-    if(argc != 2){
-        printf("ERROR 1: Invalid number of parameters\n");
-        return 1;
+    for(int i = 0; i < elements; i++){
+        profile.count[i] = profile.ns[i] = profile.entries[i] = 0;
+        profile.label[i] = -1;
     }
 
-    if(!valid_extension(argv[1])){
-        printf("ERROR 10: The file extension is not valid\n");
-        return 10;
-    }
+    for(int i = 0; i + 2 < elements; i++) //Uses the same rule of jump to find the labels
+        if(strncmp(code[i].string, "label", D) == 0)
+            profile.label[i + 2] = i;
 
-    fp = fopen(argv[1], "r");
+    profile.last = -1;
+}
 
-    if(fp == NULL){
-        printf("ERROR 2: The file does not exist\n");
-        return 2;
-    }
+void profile_step(int i){
+    long long now = now_ns();
 
+    if(profile.last != -1) profile.ns[profile.last] += now - profile.start; //The previous instruction ends when this one starts
+    profile.count[i]++;
+    if(profile.label[i] != -1) profile.entries[profile.label[i]]++;
 
-    //This cycle counts the number of tokens that will compose the array of strings
-    while(sfscanf(fp, line, D, &pos, &carriage) != EOF)
-        elements++;
-    pos = 1;
+    profile.last = i;
+    profile.start = now;
+}
 
-    token code[elements];
-    fseek(fp, 0, SEEK_SET); //Restores the original file pointer's position
+void profile_stop(){ //Closes the timing of the last executed instruction
+    if(profile.last != -1) profile.ns[profile.last] += now_ns() - profile.start;
+    profile.last = -1;
+}
 
-    
-    int comment = 0, i = 0;
-    while(sfscanf(fp, line, D, &pos, &carriage) && i < elements){ //Copies all of the tokens inside the array of strings
+void json_string(FILE *fp, char s[]){ //Prints the string escaping the characters that are not allowed by JSON
+    fputc('"', fp);
+    for(; *s != '\0'; s++){
+        if(*s == '"' || *s == '\\') fprintf(fp, "\\%c", *s);
+        else if((unsigned char)*s < ' ') fprintf(fp, "\\u%04x", *s);
+        else fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
 
-        if(strncmp(line, "-->", D) == 0) comment = 1;
-        if(strncmp(line, "<--", D) == 0){
-            comment = 0;
-            continue;
+/*Prints on stderr the source file with the executions and the share of the time of every line, then saves the
+same data with the single instructions and the label entries in filename.prof.json*/
+void print_profile(char filename[], token code[], int elements){
+    int lines = code[elements].line + 1;
+    long *line_count = arena_alloc(&program_arena, lines * sizeof(long));
+    long long *line_ns = arena_alloc(&program_arena, lines * sizeof(long long));
+    long total = 0;
+    long long total_ns = 0;
+    char line[D], name[D + 16];
+    FILE *fp;
+
+    profile_stop();
+
+    for(int i = 0; i < lines; i++) line_count[i] = line_ns[i] = 0;
+    for(int i = 0; i < elements; i++){
+        if(code[i].file == 0){ //The listing shows only the given file
+            line_count[code[i].line] += profile.count[i];
+            line_ns[code[i].line] += profile.ns[i];
         }
-        if(!comment){
-            if(strncmp(line, "", D) == 0) break;
-            strncpy(code[i].string, line, D);
-            code[i].line = pos;
+        total += profile.count[i];
+        total_ns += profile.ns[i];
+    }
 
-            i++;
+    fflush(stdout);
+    fprintf(stderr, "\nPROFILE: %ld instructions in %.3f ms\n", total, total_ns / 1e6);
+    fprintf(stderr, "%12s %8s %6s |\n", "count", "time", "line");
+
+    if((fp = fopen(filename, "r")) != NULL){
+        int n = 1, new_line = 1;
+
+        while(fgets(line, D, fp) != NULL){
+            if(new_line && n < lines && line_count[n] > 0)
+                fprintf(stderr, "%12ld %7.2f%% %6d | %s", line_count[n], total_ns ? 100.0 * line_ns[n] / total_ns : 0, n, line);
+            else if(new_line)
+                fprintf(stderr, "%12s %8s %6d | %s", "", "", n, line);
+            else
+                fputs(line, stderr); //The rest of a line longer than the buffer
+
+            new_line = strchr(line, '\n') != NULL;
+            if(new_line) n++;
         }
+        if(!new_line) fputc('\n', stderr);
+        fclose(fp);
     }
 
+    for(int i = 0; i < elements; i++)
+        if(profile.label[i] != -1 && profile.entries[profile.label[i]] > 0 && profile.label[i] == i - 2)
+            fprintf(stderr, "label %s (line %d) entered %ld times\n", code[i - 1].string, code[i - 2].line, profile.entries[i - 2]);
 
+    snprintf(name, sizeof(name), "%s.prof.json", filename);
+    if((fp = fopen(name, "w")) == NULL){
+        fprintf(stderr, "The profile can't be saved in %s\n", name);
+        return;
+    }
 
-    strncpy(code[i].string, "halt", D);
+    fprintf(fp, "{\n  \"program\": ");
+    json_string(fp, filename);
+    fprintf(fp, ",\n  \"instructions\": %ld,\n  \"ns\": %lld,\n  \"lines\": [", total, total_ns);
+    for(int i = 1, first = 1; i < lines; i++){
+        if(line_count[i] == 0) continue;
+        fprintf(fp, "%s\n    {\"line\": %d, \"count\": %ld, \"ns\": %lld}", first ? "" : ",", i, line_count[i], line_ns[i]);
+        first = 0;
+    }
+    fprintf(fp, "\n  ],\n  \"pcs\": [");
+    for(int i = 0, first = 1; i < elements; i++){
+        if(profile.count[i] == 0) continue;
+        fprintf(fp, "%s\n    {\"pc\": %d, \"file\": ", first ? "" : ",", i);
+        json_string(fp, code[i].file == 0 ? filename : modules[code[i].file].path);
+        fprintf(fp, ", \"line\": %d, \"op\": ", code[i].line);
+        json_string(fp, code[i].string);
+        fprintf(fp, ", \"count\": %ld, \"ns\": %lld}", profile.count[i], profile.ns[i]);
+        first = 0;
+    }
+    fprintf(fp, "\n  ],\n  \"labels\": [");
+    for(int i = 0, first = 1; i + 2 < elements; i++){
+        if(profile.label[i + 2] != i) continue;
+        fprintf(fp, "%s\n    {\"name\": ", first ? "" : ",");
+        json_string(fp, code[i + 1].string);
+        fprintf(fp, ", \"line\": %d, \"entries\": %ld}", code[i].line, profile.entries[i]);
+        first = 0;
+    }
+    fprintf(fp, "\n  ]\n}\n");
     fclose(fp);
+}
 
-    if(!initial_debug(code, elements)) return 9;
+//################################# - end of the section - #################################################
 
-    //This cycle contains the actual interpretation of the given code
-    for(int i = 0; i < elements; i++){
+//################################# - Trace section - ######################################################
 
-        if(strncmp(code[i].string, "push", D) == 0){
-            if(i + 1 < elements){
-                if(real_number(code[i + 1].string)){ /*This check is needed because if the given string can't be turned in a number, the atoi functions returns 0
-                                                but the user would like to insert 0, so if the argument of add is not a valid number, the interpreter will
-                                                return an error.*/
-                    push(&stack, atof(code[i + 1].string), "");
-                }
-                else{
-                    printf("ERROR 3: The argument at line %d is not a number\n", code[i].line);
-                    return 3;
-                }
-            }
-            i++;
-        }
+/*The trace keeps the last executed instructions in a ring buffer. Writing an entry is just a store and an increment,
+the buffer is printed only on an error, at halt or when the process receives SIGUSR1*/
+struct trace_entry{
+    int pc;
+    int empty; //Set when the stack was empty
+    float top; //The value on top of the stack before the instruction
+};
 
-        else if(strncmp(code[i].string, "pop", D) == 0){
-            if(!pop(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
-        }
+struct{
+    struct trace_entry *entries;
+    unsigned int size; //Always a power of two, so the position wraps with a mask
+    unsigned int next;
+}trace;
 
-        else if(strncmp(code[i].string, "dup", D) == 0){
-            if(!dup(stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
-        }
+volatile sig_atomic_t trace_requested = 0;
 
-        else if(strncmp(code[i].string, "clear", D) == 0)
-            clear(&stack);
-        
-        else if(strncmp(code[i].string, "swap", D) == 0){
-            if(!swap(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+void trace_signal(int sig){
+    (void)sig;
+    trace_requested = 1;
+}
 
-        else if(strncmp(code[i].string, "sum", D) == 0){
-            if(!sum(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+void trace_init(){
+    trace.size = 1;
+    while(trace.size < (unsigned int)options.trace) trace.size <<= 1;
+    trace.entries = arena_alloc(&program_arena, trace.size * sizeof(struct trace_entry));
+    trace.next = 0;
 
-        else if(strncmp(code[i].string, "sub", D) == 0){
-            if(!sub(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+    signal(SIGUSR1, trace_signal);
+}
 
-        else if(strncmp(code[i].string, "mult", D) == 0){
-            if(!mult(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+void trace_dump(token code[]){
+    unsigned int first = trace.next > trace.size ? trace.next - trace.size : 0;
 
-        else if(strncmp(code[i].string, "div", D) == 0){
-            if(!my_div(&stack)){
-                printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
-                return 5;
-            }
-        }
-        
-        else if(strncmp(code[i].string, "rem", D) == 0){
-            if(!rem(&stack)){
-                printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+    fflush(stdout);
+    fprintf(stderr, "\nTRACE: last %u instructions, oldest first\n", trace.next - first);
+    for(unsigned int n = first; n != trace.next; n++){
+        struct trace_entry *e = &trace.entries[n & (trace.size - 1)];
 
-        else if(strncmp(code[i].string, "toint", D) == 0){
-            if(!toint(stack)){
-                printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+        fprintf(stderr, "pc %-6d line %-6d %-10s", e->pc, code[e->pc].line, code[e->pc].string);
+        if(e->empty) fprintf(stderr, " top: empty\n");
+        else fprintf(stderr, " top: %.3f\n", e->top);
+    }
+}
 
-        else if(strncmp(code[i].string, "inc", D) == 0){
-            if(!inc(stack)){
-                printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+void trace_step(token code[], int i, struct stack *stack){
+    struct trace_entry *e = &trace.entries[trace.next++ & (trace.size - 1)];
 
-        else if(strncmp(code[i].string, "dec", D) == 0){
-            if(!dec(stack)){
-                printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+    e->pc = i;
+    e->empty = stack->size == 0;
+    if(stack->size > 0) e->top = stack->values[stack->size - 1];
 
-        else if(strncmp(code[i].string, "and", D) == 0){
-            if(!and(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+    if(trace_requested){
+        trace_requested = 0;
+        trace_dump(code);
+    }
+}
 
-        else if(strncmp(code[i].string, "or", D) == 0){
-            if(!or(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+int trace_halted(token code[]){ //Checks if the last traced instruction is a halt
+    return trace.next > 0 && strncmp(code[trace.entries[(trace.next - 1) & (trace.size - 1)].pc].string, "halt", D) == 0;
+}
 
-        else if(strncmp(code[i].string, "not", D) == 0){
-            if(!not(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+//################################# - end of the section - #################################################
 
-        else if(strncmp(code[i].string, "xor", D) == 0){
-            if(!xor(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+//################################# - Sampling section - ###################################################
 
-        else if(strncmp(code[i].string, "lshift", D) == 0){
-            if(!lshift(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+#define SAMPLE_INTERVAL 1000 //Microseconds of cpu time between two samples
 
-        else if(strncmp(code[i].string, "rshift", D) == 0){
-            if(!rshift(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+/*The sampler doesn't measure the single instructions: a SIGPROF timer interrupts the program and the handler
+counts a hit for the instruction that was running, so the loop only has to publish its position*/
+struct{
+    volatile int pc; //Instruction being executed
+    volatile long *hits; //Samples taken on each token
+    volatile long total;
+}sampler;
 
-        else if(strncmp(code[i].string, "print", D) == 0){
-            if(i + 1 < elements){
-                int len = strlen(code[i + 1].string);
-                char temp[len];
-                if(i + 1 < elements && code[i + 1].string[0] == '\"' && code[i + 1].string[len - 1] == '\"'){
-                    prepare_string(code[i + 1].string, len, temp);
-                    printf("%s", temp);
-                }
-                else{
-                    printf("ERROR 6: The argument at line %d is not a string\n", code[i].line);
-                    return 6;
-                }
-            }
-            i++; //Skips to the next instruction
-            continue;
-        }
+void sample_signal(int sig){
+    (void)sig;
+    if(sampler.pc >= 0){
+        sampler.hits[sampler.pc]++;
+        sampler.total++;
+    }
+}
 
-        else if(strncmp(code[i].string, "printnl", D) == 0){
-            if(i + 1 < elements){
-                int len = strlen(code[i + 1].string);
-                char temp[len];
-                if(i + 1 < elements && code[i + 1].string[0] == '\"' && code[i + 1].string[len - 1] == '\"'){
-                    prepare_string(code[i + 1].string, len, temp);
-                    printf("%s\n", temp);
-                }
-                else{
-                    printf("ERROR 6: The argument at line %d is not a string\n", code[i].line);
-                    return 6;
-                }
-            }
-            i++; //Skips to the next instruction, avoiding the argument
-            continue;
-        }
+void sample_init(int elements){
+    struct sigaction sa;
+    struct itimerval timer = {{0, SAMPLE_INTERVAL}, {0, SAMPLE_INTERVAL}};
+
+    sampler.hits = arena_alloc(&program_arena, elements * sizeof(long));
+    for(int i = 0; i < elements; i++) sampler.hits[i] = 0;
+    sampler.pc = -1;
+    sampler.total = 0;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sample_signal;
+    sa.sa_flags = SA_RESTART; //The input functions must not fail because of a sample
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
 
-        else if(strncmp(code[i].string, "in", D) == 0){
-            in(&stack, 0);
-        }
+/*Stops the timer, prints on stderr the samples of every line from the most to the least sampled and saves them
+in filename.folded as label;line stacks, the format read by the flame graph tools*/
+void print_samples(char filename[], token code[], int elements){
+    struct itimerval stop = {{0, 0}, {0, 0}};
+    int lines = code[elements].line + 1;
+    long *line_hits = arena_alloc(&program_arena, lines * sizeof(long));
+    int *line_label = arena_alloc(&program_arena, lines * sizeof(int)); //Label that contains each line, -1 for the code before the first one
+    long modules_hits = 0;
+    char name[D + 16];
+    FILE *fp;
 
-        else if(strncmp(code[i].string, "inchar", D) == 0){
-            in(&stack, 1);
-        }
+    setitimer(ITIMER_PROF, &stop, NULL);
+    sampler.pc = -1;
 
-        else if(strncmp(code[i].string, "out", D) == 0){
-            if(!out(stack, 0)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
+    for(int i = 0; i < lines; i++){
+        line_hits[i] = 0;
+        line_label[i] = -1;
+    }
+    for(int i = 0, label = -1; i < elements; i++){
+        if(i + 1 < elements && strncmp(code[i].string, "label", D) == 0) label = i + 1;
+        if(code[i].file != 0){ //The lines of the included files are counted together
+            modules_hits += sampler.hits[i];
+            continue;
         }
+        line_hits[code[i].line] += sampler.hits[i];
+        if(sampler.hits[i] > 0) line_label[code[i].line] = label;
+    }
 
-        else if(strncmp(code[i].string, "outint", D) == 0){
-            if(!out(stack, 1)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+    fflush(stdout);
+    fprintf(stderr, "\nSAMPLES: %ld, one every %d us of cpu time\n", sampler.total, SAMPLE_INTERVAL);
+    fprintf(stderr, "%10s %8s %6s  %s\n", "samples", "share", "line", "label");
+    while(1){ //Selection of the most sampled line still to print
+        int max = 0;
 
-        else if(strncmp(code[i].string, "outchar", D) == 0){
-            if(!out(stack, 2)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
-        }
+        for(int i = 1; i < lines; i++)
+            if(line_hits[i] > line_hits[max]) max = i;
+        if(line_hits[max] == 0) break;
 
-        else if(strncmp(code[i].string, "sclear", D) == 0){
-            sclear();
-        }
+        fprintf(stderr, "%10ld %7.2f%% %6d  %s\n", line_hits[max], 100.0 * line_hits[max] / sampler.total, max, line_label[max] == -1 ? "(main)" : code[line_label[max]].string);
+        line_hits[max] = -line_hits[max]; //Marks the line as printed
+    }
+    if(modules_hits > 0)
+        fprintf(stderr, "%10ld %7.2f%%         (included files)\n", modules_hits, 100.0 * modules_hits / sampler.total);
 
-        else if(strncmp(code[i].string, "ifeq", D) == 0){
-            int result = if_eq(&stack);
-            
-            if(result == -1){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
+    snprintf(name, sizeof(name), "%s.folded", filename);
+    if((fp = fopen(name, "w")) == NULL){
+        fprintf(stderr, "The samples can't be saved in %s\n", name);
+        return;
+    }
+    for(int i = 0, label = -1; i < elements; i++){ //The tools add up the stacks of the instructions on the same line
+        if(i + 1 < elements && strncmp(code[i].string, "label", D) == 0) label = i + 1;
+        if(sampler.hits[i] > 0)
+            fprintf(fp, "%s;%s;line %d %ld\n", code[i].file == 0 ? filename : modules[code[i].file].path, label == -1 ? "(main)" : code[label].string, code[i].line, sampler.hits[i]);
+    }
+    fclose(fp);
+}
 
-            if(result == 0){
-                int valid = next_valid_instruction(code, elements, i);
-                i = valid;
-            }
-        }
+//################################# - end of the section - #################################################
 
-        else if(strncmp(code[i].string, "ifdif", D) == 0){
-            int result = if_dif(&stack);
-            
-            if(result == -1){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
+//################################# - Watchdog section - ###################################################
 
-            if(result == 0){
-                int valid = next_valid_instruction(code, elements, i);
-                i = valid;
-            }
-        }
+/*The limits are checked only when the program jumps (goto and the ends of the loops), since a program that never
+jumps always reaches its end. The timer just sets a flag, so every check costs a counter and two comparisons*/
+long long steps = 0; //Jumps done by the program
+long long step_limit = LLONG_MAX; //The next step that needs a check, the step limit or the next checkpoint
+int checkpoint_writing = 0; //Set in the copy of the process that writes a checkpoint
 
-        else if(strncmp(code[i].string, "ifgr", D) == 0){
-            int result = if_gr(&stack);
-            
-            if(result == -1){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
+void watchdog_signal(int sig){
+    (void)sig;
+    expired = 1;
+}
 
-            if(result == 0){
-                int valid = next_valid_instruction(code, elements, i);
-                i = valid;
-            }
-        }
+void watchdog_init(){
+    struct sigaction sa;
+    struct itimerval timer = {{0, 0}, {options.timeout / 1000, (options.timeout % 1000) * 1000}};
 
-        else if(strncmp(code[i].string, "iflw", D) == 0){
-            int result = if_lw(&stack);
-            
-            if(result == -1){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = watchdog_signal;
+    sa.sa_flags = 0; //A blocked input is interrupted, so the watchdog can stop it
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, NULL);
+    setitimer(ITIMER_REAL, &timer, NULL);
+}
 
-            if(result == 0){
-                int valid = next_valid_instruction(code, elements, i);
-                i = valid;
-            }
-        }
+int limit_exceeded(token code[], int i){ //Reports which limit stopped the program
+    printf("ERROR 15: The program exceeded the %s limit at line %d, step %lld\n", expired ? "time" : "steps", code[i].line, steps);
+    return 15;
+}
 
-        else if(strncmp(code[i].string, "iftrue", D) == 0){
-            int result = if_true(&stack);
-            
-            if(result == -1){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
+//################################# - end of the section - #################################################
 
-            if(result == 0){
-                int valid = next_valid_instruction(code, elements, i);
-                i = valid;
-            }
-        }
+//################################# - Timing section - #####################################################
 
-        else if(strncmp(code[i].string, "iffalse", D) == 0){
-            int result = if_false(&stack);
-            
-            if(result == -1){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
-            }
+/*The names of the marks are numbered by the linker, so mark, elapsed and timing find their time in an array.
+The stack holds floats, whose 24 bits of precision can't represent the value of the monotonic clock, so clock pushes
+the time passed since the start of the run*/
+struct{
+    long long start; //Start of the run
+    long long *marks; //The time saved by every mark, -1 until it's saved
+    int count;
+    FILE *out; //Receives the samples of timing
+}timing;
 
-            if(result == 0){
-                int valid = next_valid_instruction(code, elements, i);
-                i = valid;
-            }
-        }
+int is_timing_instruction(char string[]){
+    return strncmp(string, "mark", D) == 0 || strncmp(string, "elapsed", D) == 0 || strncmp(string, "timing", D) == 0;
+}
+
+void link_marks(token code[], int elements){ //Gives to every mark name its position in the array
+    char **names = arena_alloc(&program_arena, (elements + 1) * sizeof(char *));
 
-        else if(strncmp(code[i].string, "endif", D) == 0){
-            continue; //Does nothing
+    timing.count = 0;
+    for(int i = 0; i + 1 < elements; i++){
+        if(is_timing_instruction(code[i].string)){
+            int k;
+
+            for(k = 0; k < timing.count && strncmp(names[k], code[i + 1].string, NAME_SIZE) != 0; k++);
+            if(k == timing.count) names[timing.count++] = code[i + 1].string;
+            code[i].slot = k;
         }
+    }
 
-        else if(strncmp(code[i].string, "goto", D) == 0){
-            int j;
+    timing.marks = arena_alloc(&program_arena, (timing.count + 1) * sizeof(long long));
+    for(int k = 0; k < timing.count; k++) timing.marks[k] = -1;
+}
 
-            if((i + 1) >= elements){ //Checks for the existence of the label
-                printf("ERROR 6: The label at line %d doesn't exist\n", code[i].line);
-                return 6;
-            }
+int since_mark(token code[], int i, long long *ns){ //The nanoseconds passed since the mark of the instruction, 0 if it was never saved
+    long long mark = timing.marks[code[i].slot];
 
+    if(mark == -1) return 0;
+    *ns = now_ns() - mark;
+    return 1;
+}
 
-            if((j = jump(code, elements, code[i + 1].string)) == -1){
-                printf("ERROR 6: The label at line %d doesn't exist\n", code[i].line);
-                return 6;
-            }
-            i = j;
-        }
+//################################# - end of the section - #################################################
 
-        else if(strncmp(code[i].string, "var", D) == 0){
-            if(i + 1 < elements){
-                push(&varstack, 0, code[i + 1].string); //Sets the default variable value to 0
-                i++;
-            }
-        }
+//################################# - Coverage section - ###################################################
 
-        else if(strncmp(code[i].string, "store", D) == 0){
+/*Every executed instruction sets its bit in a bitmap allocated before the run. Only the first execution pays for
+it: the opcodes are translated with the OP_UNCOVERED flag, which the first execution clears after setting the bit.
+At the end the bits are grouped by line: a line is hit when at least one of its instructions was executed and
+missed when none was. The arguments and the instructions that do nothing (label, endif, local) aren't counted,
+since a jump can land after them*/
+struct{
+    unsigned long long *bits;
+}coverage;
 
-            if(i + 1 < elements){
-                if(!store(varstack, stack, code[i + 1].string)){
-                    printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
-                    return 7;
-                }
-            }
-            i++;
-        }
+void coverage_init(int elements){
+    coverage.bits = arena_alloc(&program_arena, (elements / 64 + 1) * sizeof(unsigned long long));
+    memset(coverage.bits, 0, (elements / 64 + 1) * sizeof(unsigned long long));
+}
 
-        else if(strncmp(code[i].string, "pstore", D) == 0){
+int executed(int i){
+    return (coverage.bits[i >> 6] >> (i & 63)) & 1;
+}
 
-            if(i + 1 < elements){
-                if(stack == NULL){
-                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                    return 4;
-                }
+int has_argument(token code[], int elements, int i);
 
-                if(!store(varstack, stack, code[i + 1].string)){
-                    printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
-                    return 7;
-                }
-            }
-            pop(&stack);
-            i++;
-        }
+char *coverable(token code[], int elements){ //Marks the tokens counted by the coverage
+    char *counted = arena_alloc(&program_arena, elements + 1);
 
-        else if(strncmp(code[i].string, "load", D) == 0){
+    memset(counted, 0, elements + 1);
+    for(int i = 0; i < elements; i = i + 1 + has_argument(code, elements, i))
+        counted[i] = strncmp(code[i].string, "label", D) != 0 && strncmp(code[i].string, "endif", D) != 0 && strncmp(code[i].string, "local", D) != 0;
 
-            if(i + 1 < elements){
-                if(!load(varstack, &stack, code[i + 1].string)){
-                    printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
-                    return 7;
-                }
-            }
-            i++;
-        }
+    return counted;
+}
 
-        else if(strncmp(code[i].string, "del", D) == 0){
+/*Saves the hit and missed lines of every file in the given JSON file, then prints on stderr the source of the
+program with every line marked*/
+void print_coverage(char filename[], token code[], int elements){
+    char *counted = coverable(code, elements);
+    int total = 0, hit = 0, total_lines = 0, hit_lines = 0;
+    int main_lines = 0, *main_count = NULL, *main_executed = NULL;
+    char line[D];
+    FILE *fp;
 
-            if(i + 1 < elements){
-                if(!delete_var(&varstack, code[i + 1].string)){
-                    printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
-                    return 7;
-                }
-            }
-            i++;
+    for(int i = 0; i < elements; i++)
+        if(counted[i]){
+            total++;
+            hit += executed(i);
         }
 
-        else if(strncmp(code[i].string, "randint", D) == 0){
-            if(i + 1 < elements){
-                if(real_number(code[i + 1].string)){
-                    randint(&stack, atof(code[i + 1].string));
-                }
-                else{
-                    printf("ERROR 3: The argument at line %d is not a number\n", code[i].line);
-                    return 3;
-                }
-            }
-            i++;
-        }
+    if((fp = fopen(options.coverage, "w")) == NULL)
+        fprintf(stderr, "The coverage can't be saved in %s\n", options.coverage);
+    else{
+        fprintf(fp, "{\n  \"program\": ");
+        json_string(fp, filename);
+        fprintf(fp, ",\n  \"instructions\": %d,\n  \"executed\": %d,\n  \"files\": [", total, hit);
+    }
 
-        else if(strncmp(code[i].string, "vclear", D) == 0)
-            clear(&stack);
+    for(int f = 0; f < module_count || f == 0; f++){
+        int lines = 0;
 
-        else if(strncmp(code[i].string, "abs", D) == 0){
-            if(!my_abs(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
-        }
+        for(int i = 0; i < elements; i++)
+            if(code[i].file == f && code[i].line >= lines) lines = code[i].line + 1;
 
-        else if(strncmp(code[i].string, "pow", D) == 0){
-            if(!my_pow(&stack)){
-                printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
-                return 5;
+        int *count = arena_alloc(&program_arena, (lines + 1) * sizeof(int));
+        int *done = arena_alloc(&program_arena, (lines + 1) * sizeof(int));
+        memset(count, 0, (lines + 1) * sizeof(int));
+        memset(done, 0, (lines + 1) * sizeof(int));
+        for(int i = 0; i < elements; i++)
+            if(code[i].file == f && counted[i]){
+                count[code[i].line]++;
+                done[code[i].line] += executed(i);
             }
-        }
 
-        else if(strncmp(code[i].string, "ln", D) == 0){
-            if(!ln(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
+        if(fp != NULL){
+            fprintf(fp, "%s\n    {\"file\": ", f > 0 ? "," : "");
+            json_string(fp, f == 0 ? filename : modules[f].path);
+            fprintf(fp, ", \"lines\": [");
         }
-
-        else if(strncmp(code[i].string, "log", D) == 0){
-            if(!my_log(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
+        for(int n = 1, first = 1; n < lines; n++){
+            if(count[n] == 0) continue;
+            total_lines++;
+            hit_lines += done[n] > 0;
+            if(fp != NULL) fprintf(fp, "%s\n      {\"line\": %d, \"hit\": %s, \"instructions\": %d, \"executed\": %d}",
+                                   first ? "" : ",", n, done[n] > 0 ? "true" : "false", count[n], done[n]);
+            first = 0;
         }
+        if(fp != NULL) fprintf(fp, "\n    ]}");
 
-        else if(strncmp(code[i].string, "ceil", D) == 0){
-            if(!my_ceil(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
+        if(f == 0){
+            main_lines = lines;
+            main_count = count;
+            main_executed = done;
         }
+    }
 
-        else if(strncmp(code[i].string, "logtwo", D) == 0){
-            if(!logtw(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
-        }
+    if(fp != NULL){
+        fprintf(fp, "\n  ]\n}\n");
+        fclose(fp);
+    }
 
-        else if(strncmp(code[i].string, "sqrt", D) == 0){
-            if(!my_sqrt(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
-        }
+    fflush(stdout);
+    fprintf(stderr, "\nCOVERAGE: %d of %d lines, %d of %d instructions\n", hit_lines, total_lines, hit, total);
+    if((fp = fopen(filename, "r")) != NULL){ //The listing shows only the given file
+        int n = 1, new_line = 1;
 
-        else if(strncmp(code[i].string, "sin", D) == 0){
-            if(!my_sin(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
+        while(fgets(line, D, fp) != NULL){
+            if(new_line){
+                char *mark = n >= main_lines || main_count[n] == 0 ? "" : main_executed[n] == 0 ? "MISSED" : main_executed[n] < main_count[n] ? "partial" : "hit";
+                fprintf(stderr, "%8s %6d | %s", mark, n, line);
             }
-        }
+            else
+                fputs(line, stderr);
 
-        else if(strncmp(code[i].string, "cos", D) == 0){
-            if(!my_cos(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
+            new_line = strchr(line, '\n') != NULL;
+            if(new_line) n++;
         }
+        if(!new_line) fputc('\n', stderr);
+        fclose(fp);
+    }
+}
 
-        else if(strncmp(code[i].string, "tan", D) == 0){
-            if(!my_tan(&stack)){
-                printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
-                return 4;
-            }
-        }
+//################################# - end of the section - #################################################
 
-        else if(strncmp(code[i].string, "stack", D) == 0){
-            printlist(stack);
-        }
-        else if(strncmp(code[i].string, "label", D) == 0){
-            if((i + 1) > elements){
-                printf("ERROR 6: The label at line %d doesn't exist\n", code[i].line);
-                return 6;
-            }
-            i++;
-        }
+//################################# - Perf counters section - ##############################################
+
+#define PERF_EVENTS 4
+#define PERF_CLASSES 6
+
+/*--perf-counters reads the hardware counters of the cpu around the run with perf_event_open: the cycles, the
+machine instructions, the mispredicted branches and the misses of the L1 data cache, counted only in user space.
+Every event is opened in the same group, read in one go, and the events the cpu or the kernel doesn't offer are left
+out instead of stopping the run. --perf-classes reads the group before every instruction too and charges the
+difference to the class of the previous one; the cost of the read itself, measured at the start, is subtracted*/
+struct{
+    int fd[PERF_EVENTS]; //-1 for the events that can't be opened
+    int leader; //The first opened event, the group is enabled and read through it
+    int count; //Opened events, in the order of fd
+    unsigned long long start[PERF_EVENTS]; //Values of the last read
+    unsigned long long totals[PERF_EVENTS];
+    unsigned long long overhead[PERF_EVENTS]; //What a read costs, removed from every class
+    unsigned long long classes[PERF_CLASSES][PERF_EVENTS];
+    long long executed[PERF_CLASSES]; //Instructions of the program executed by every class
+    unsigned char *class; //Class of every token
+    int last; //Instruction being measured, -1 before the first
+    int error; //errno of the first event, when none of them can be opened
+}perf;
+
+struct{
+    char *name;
+    unsigned int type;
+    unsigned long long config;
+}perf_events[PERF_EVENTS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"L1-dcache-misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16}
+};
 
-        else if(strncmp(code[i].string, "halt", D) == 0) break;
+//The classes follow the groups of the list of operations, the instructions that aren't listed belong to other
+char *perf_class_names[PERF_CLASSES] = {"stack", "math", "control", "variables", "io", "other"};
+char *perf_class_members[PERF_CLASSES - 1] = {
+    " push pop dup clear swap over rot pick roll drop depth sort rsort usort stack ",
+    " sum sub mult div rem toint inc dec and or not xor lshift rshift abs pow ln log logtwo ceil sqrt sin cos tan ",
+    " ifeq ifdif ifgr iflw iftrue iffalse endif label goto repeat endrepeat while endwhile index call ret cocreate resume yield halt ",
+    " var del store pstore load vclear local shvar fetchadd cas ",
+    " print printnl in inchar eof out outint outchar sclear "
+};
 
-        else{
-            printf("ERROR 8: Unknown token in line %d\n", code[i].line);
-            return 8;
+int perf_class(char string[]){
+    char name[NAME_SIZE + 2];
+
+    snprintf(name, sizeof(name), " %.*s ", NAME_SIZE - 1, string);
+    for(int k = 0; k < PERF_CLASSES - 1; k++)
+        if(strstr(perf_class_members[k], name) != NULL) return k;
+
+    return PERF_CLASSES - 1;
+}
+
+int perf_read(unsigned long long values[]){ //Reads the group, the values follow the order of fd
+    unsigned long long buffer[3 + PERF_EVENTS]; //The number of events, the times enabled and running, then the values
+    double scale;
+
+    if(read(perf.leader, buffer, sizeof(buffer)) < (ssize_t)((3 + perf.count) * sizeof(unsigned long long))) return 0;
+
+    scale = buffer[2] > 0 ? (double)buffer[1] / buffer[2] : 1; //The group shared the cpu counters with other groups
+    for(int k = 0; k < perf.count; k++) values[k] = scale > 1 ? buffer[3 + k] * scale : buffer[3 + k];
+    return 1;
+}
+
+int perf_init(token code[], int elements){ //Opens the events, 0 if none of them is available
+    struct perf_event_attr attr;
+
+    perf.leader = -1;
+    perf.count = 0;
+    perf.error = 0;
+    for(int k = 0; k < PERF_EVENTS; k++){
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_events[k].type;
+        attr.config = perf_events[k].config;
+        attr.disabled = perf.leader == -1; //Only the leader starts the group
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        perf.fd[k] = syscall(SYS_perf_event_open, &attr, 0, -1, perf.leader, 0);
+        if(perf.fd[k] == -1){
+            if(perf.leader == -1 && perf.error == 0) perf.error = errno;
+            continue;
+        }
+        if(perf.leader == -1) perf.leader = perf.fd[k];
+        perf.count++;
+    }
+    if(perf.leader == -1) return 0;
+
+    memset(perf.totals, 0, sizeof(perf.totals));
+    memset(perf.classes, 0, sizeof(perf.classes));
+    memset(perf.executed, 0, sizeof(perf.executed));
+    perf.last = -1;
+
+    if(options.perf_classes){
+        unsigned long long a[PERF_EVENTS], b[PERF_EVENTS];
+
+        perf.class = arena_alloc(&program_arena, elements + 1);
+        for(int i = 0; i < elements; i++) perf.class[i] = perf_class(code[i].string);
+
+        ioctl(perf.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        for(int k = 0; k < PERF_EVENTS; k++) perf.overhead[k] = ULLONG_MAX;
+        for(int n = 0; n < 64 && perf_read(a) && perf_read(b); n++) //The cheapest of a few reads back to back
+            for(int k = 0; k < perf.count; k++)
+                if(b[k] - a[k] < perf.overhead[k]) perf.overhead[k] = b[k] - a[k];
+        ioctl(perf.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        for(int k = 0; k < perf.count; k++) if(perf.overhead[k] == ULLONG_MAX) perf.overhead[k] = 0;
+    }
+
+    return 1;
+}
+
+void perf_start(){
+    ioctl(perf.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    if(!perf_read(perf.start)) memset(perf.start, 0, sizeof(perf.start));
+}
+
+void perf_step(int i){ //Charges the counters since the last read to the class of the previous instruction
+    unsigned long long now[PERF_EVENTS];
+
+    if(!perf_read(now)) return;
+    if(perf.last != -1){
+        int class = perf.class[perf.last];
+
+        for(int k = 0; k < perf.count; k++){
+            unsigned long long delta = now[k] - perf.start[k];
+
+            perf.classes[class][k] += delta > perf.overhead[k] ? delta - perf.overhead[k] : 0;
+        }
+        perf.executed[class]++;
+    }
+
+    perf.last = i;
+    perf_read(perf.start); //The time spent here isn't charged to the next instruction
+}
+
+void perf_stop(){
+    unsigned long long now[PERF_EVENTS];
+
+    if(options.perf_classes) perf_step(-1);
+    if(perf_read(now))
+        for(int k = 0; k < perf.count; k++) perf.totals[k] = now[k];
+    ioctl(perf.leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for(int k = 0; k < PERF_EVENTS; k++) if(perf.fd[k] != -1) close(perf.fd[k]);
+}
+
+void perf_value(unsigned long long values[], int event, unsigned long long *value){ //Finds the value of the event among the opened ones
+    int position = 0;
+
+    for(int k = 0; k < event; k++) if(perf.fd[k] != -1) position++;
+    *value = perf.fd[event] != -1 ? values[position] : 0;
+}
+
+void print_perf_line(char name[], unsigned long long values[], long long executed){
+    unsigned long long v[PERF_EVENTS];
+
+    for(int k = 0; k < PERF_EVENTS; k++) perf_value(values, k, &v[k]);
+
+    fprintf(stderr, "%-10s", name);
+    if(executed >= 0) fprintf(stderr, " %14lld", executed);
+    for(int k = 0; k < PERF_EVENTS; k++){
+        if(perf.fd[k] == -1) fprintf(stderr, " %16s", "-");
+        else fprintf(stderr, " %16llu", v[k]);
+    }
+    if(perf.fd[0] != -1 && perf.fd[1] != -1 && v[0] > 0) fprintf(stderr, " %6.2f", (double)v[1] / v[0]);
+    else fprintf(stderr, " %6s", "-");
+    for(int k = 2; k < PERF_EVENTS; k++){
+        if(perf.fd[k] != -1 && perf.fd[1] != -1 && v[1] > 0) fprintf(stderr, " %10.6f", (double)v[k] / v[1]);
+        else fprintf(stderr, " %10s", "-");
+    }
+    fputc('\n', stderr);
+}
+
+/*Prints on stderr the counters of the run, the instructions per cycle and the misses per machine instruction,
+then the same for every class with the instructions of the program it executed*/
+void print_perf(){
+    fflush(stdout);
+    if(perf.leader == -1){
+        fprintf(stderr, "\nPERF COUNTERS: unavailable (%s)\n", strerror(perf.error));
+        return;
+    }
+
+    fprintf(stderr, "\nPERF COUNTERS: user space, - for the events that can't be counted\n");
+    fprintf(stderr, "%-10s", "");
+    if(options.perf_classes) fprintf(stderr, " %14s", "executed");
+    for(int k = 0; k < PERF_EVENTS; k++) fprintf(stderr, " %16s", perf_events[k].name);
+    fprintf(stderr, " %6s %10s %10s\n", "IPC", "br-miss/i", "L1d-miss/i");
+
+    print_perf_line("run", perf.totals, options.perf_classes ? perf.executed[0] + perf.executed[1] + perf.executed[2] +
+                    perf.executed[3] + perf.executed[4] + perf.executed[5] : -1);
+    if(options.perf_classes)
+        for(int c = 0; c < PERF_CLASSES; c++)
+            if(perf.executed[c] > 0) print_perf_line(perf_class_names[c], perf.classes[c], perf.executed[c]);
+}
+
+//################################# - end of the section - #################################################
+
+void write_checkpoint(int pc, struct stack *stack);
+
+void instrument(token code[], int i, struct stack *stack){ //Called before every instruction when an instrument is active
+    if(checkpoint_writing) write_checkpoint(i, stack); //Only in the process that writes the snapshot, it never returns
+    sampler.pc = i;
+    if(options.profile) profile_step(i);
+    if(options.trace) trace_step(code, i, stack);
+    if(options.perf_classes && perf.leader != -1) perf_step(i);
+}
+
+
+void printlist(struct stack *s){
+    if(s->size == 0){
+        printf("\nEMPTY\n");
+        return;
+    }
+
+    char buf[64];
+
+    printf("\n|");
+    for(int k = 0; k < s->size; k++){
+        int l = format_float(s->values[k], buf);
+
+        buf[l++] = '|';
+        fwrite(buf, 1, l, stdout);
+    }
+    printf("<-top\n");
+}
+
+/*This function is a secure version of fscanf that truncates the string by the length of the given string. This approach serves to avoid buffer overflow*/
+int sfscanf(FILE *fp, char string[], int l, int *line, char *carriage){
+    char c;
+    int is_string = 0;
+    int i = 0;
+
+    if(fp == NULL || string == NULL || l <= 0) return EOF;
+
+    if(*carriage == '\n'){ //Is necessary to avoid missing a \n character
+        (*line)++;
+        *carriage = '\0';
+    }
+
+    /*Scrolls the contents of the file until the character c is a valid character. This cycle is important because it skips all the indentation
+    and space charaters, leaving only the right characters*/
+    while((c = fgetc(fp)) != EOF && isspace(c)){
+        if(c == '\n'){
+            (*line)++;
+        }
+    }
+
+    if(c == EOF){ //Covers the case where in the file there's nothing valid. For example the last portion of the file could only consist in space characters
+        string[0] = '\0';
+        return EOF;
+    }
+
+    
+    if(c == '\"') is_string = 1;//Avoid the first character because it is the beginnning of a string
+    string[i++] = c; //This line of code is necesarry to avoid skipping the first charcter of the string which is a valid one
+
+    while((c = fgetc(fp)) != EOF && i < l - 1){ //Loads the string if the character c or the length are valid
+        if(is_string){
+            string[i++] = c;
+            if(c == '\"') break;
+        }
+        else{
+            if(isspace(c)){
+                if(c == '\n'){
+                    (*carriage) = '\n';
+                    
+                }
+                break;
+            }
+            else{
+                string[i++] = c;
+                (*carriage) = '\0';
+            }
+        }
+        
+    }
+
+    string[i] = '\0'; //Terminates the string
+
+    return 1;
+}
+
+
+int real_number(char s[]){ //Checks if the given number is a float
+    for(int i = 0; s[i] != '\0'; i++)
+        if((isalpha(s[i]) || ispunct(s[i])) && s[i] != '.' && s[i] != '-')
+            return 0;
+    
+    return 1;
+}
+
+//################################# - Loops section - ######################################################
+
+#define LOOP_DEPTH 256 //Defines the maximum number of nested running loops
+
+/*The running loops keep their state in these registers instead of the stack. The end of a loop is a single
+decrement (or condition) followed by a jump to the position saved here, without searching any label*/
+struct loop{
+    int start; //Position of the repeat or while
+    int body; //Position of the first instruction of the body
+    long remaining; //Iterations left, used only by repeat
+    long index; //Current iteration, starting from 0
+};
+
+int repeat_literal(token code[], int elements, int i){ //Checks if the repeat at position i is followed by its number of iterations
+    return i + 1 < elements && real_number(code[i + 1].string);
+}
+
+int iteration_count(double value, long *count){ //Returns 0 if the number of iterations is NaN, infinite or too large for a long
+    if(!(value >= (double)LONG_MIN && value < -(double)LONG_MIN)) return 0;
+
+    *count = value;
+    return 1;
+}
+
+int loop_condition(char cond[], struct stack *stack){ //Evaluates the condition of a while, -2 if the condition doesn't exist
+    if(strncmp(cond, "eq", D) == 0) return if_eq(stack);
+    if(strncmp(cond, "dif", D) == 0) return if_dif(stack);
+    if(strncmp(cond, "gr", D) == 0) return if_gr(stack);
+    if(strncmp(cond, "lw", D) == 0) return if_lw(stack);
+    if(strncmp(cond, "true", D) == 0) return if_true(stack);
+    if(strncmp(cond, "false", D) == 0) return if_false(stack);
+    return -2;
+}
+
+int loop_debug(token code[], int elements){ //Connects every loop to its end, checking that they are nested correctly
+    int *open = arena_alloc(&program_arena, (elements + 1) * sizeof(int));
+    int top = 0, valid = 1;
+
+    for(int i = 0; i < elements; i++){
+        if(strncmp(code[i].string, "repeat", D) == 0 || strncmp(code[i].string, "while", D) == 0){
+            if(code[i].string[0] == 'w'){
+                struct stack empty = {NULL, 0, 0};
+
+                if(i + 1 >= elements || loop_condition(code[i + 1].string, &empty) == -2){
+                    printf("ERROR 9: The while at line %d has no valid condition\n", code[i].line);
+                    valid = 0;
+                }
+            }
+            open[top++] = i;
+        }
+
+        else if(strncmp(code[i].string, "endrepeat", D) == 0 || strncmp(code[i].string, "endwhile", D) == 0){
+            if(top == 0 || code[open[top - 1]].string[0] != code[i].string[3]){ //The first letter of the loop must follow "end"
+                printf("ERROR 9: The %s at line %d is missing its counter part\n", code[i].string, code[i].line);
+                valid = 0;
+                continue;
+            }
+            top--;
+            code[open[top]].match = i;
+            code[i].match = open[top];
+        }
+    }
+
+    for(int i = 0; i < top; i++){
+        printf("ERROR 9: The %s at line %d is missing its counter part\n", code[open[i]].string, code[open[i]].line);
+        valid = 0;
+    }
+
+    return valid;
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Subroutines section - ################################################
+
+#define CALL_DEPTH 4096 //Defines the maximum number of nested calls
+#define FRAMES_SIZE 65536 //Defines the number of local variables available to all the nested calls
+
+/*A subroutine starts at a label used by a call and ends where the next one starts. Its local variables are
+numbered before the run, so the instructions reach them in the frame of the call without searching any name*/
+struct call{
+    int ret; //Position where the execution continues after ret
+    int base; //Position of the frame of the call among the local variables
+    int loop_floor; //The loops of the caller, which can't be ended by the subroutine
+};
+
+int is_variable_instruction(char string[]){
+    return strncmp(string, "load", D) == 0 || strncmp(string, "store", D) == 0 || strncmp(string, "pstore", D) == 0;
+}
+
+int link_subroutines(token code[], int elements){ //Connects the calls to their labels and numbers the local variables
+    int *routine = arena_alloc(&program_arena, (elements + 1) * sizeof(int)); //Marks the label instructions that start a subroutine
+    int *frame = arena_alloc(&program_arena, (elements + 1) * sizeof(int)); //The size of the frame of each subroutine
+    int valid = 1;
+
+    for(int i = 0; i <= elements; i++) routine[i] = frame[i] = 0;
+
+    for(int i = 0; i < elements; i++){
+        if(strncmp(code[i].string, "call", D) == 0){
+            int j;
+
+            if(i + 1 >= elements || (j = jump(code, elements, code[i + 1].string)) == -1){
+                printf("ERROR 6: The label at line %d doesn't exist\n", code[i].line);
+                valid = 0;
+                continue;
+            }
+            code[i].match = j;
+            routine[j - 1] = 1;
+        }
+        else if(strncmp(code[i].string, "cocreate", D) == 0){ //The coroutines start from their label like a goto
+            int j;
+
+            if(i + 1 >= elements || (j = jump(code, elements, code[i + 1].string)) == -1){
+                printf("ERROR 6: The label at line %d doesn't exist\n", code[i].line);
+                valid = 0;
+                continue;
+            }
+            code[i].match = j;
+        }
+    }
+
+    for(int start = 0, end; start < elements; start = end){ //Every subroutine is a separate range of tokens
+        int count = 0;
+
+        for(end = start + 1; end < elements && !routine[end]; end++);
+        if(!routine[start]){ //The code before the first subroutine can't have local variables
+            for(int i = start; i < end; i++)
+                if(strncmp(code[i].string, "local", D) == 0){
+                    printf("ERROR 9: The local at line %d is not inside a subroutine\n", code[i].line);
+                    valid = 0;
+                }
+            continue;
+        }
+
+        char **names = arena_alloc(&program_arena, (end - start) * sizeof(char *));
+        for(int i = start; i < end; i++){
+            if(strncmp(code[i].string, "local", D) == 0 && i + 1 < end){
+                int k;
+
+                for(k = 0; k < count && strncmp(names[k], code[i + 1].string, NAME_SIZE) != 0; k++);
+                if(k == count) names[count++] = code[i + 1].string;
+                code[i].slot = k;
+            }
+        }
+
+        for(int i = start; i + 1 < end; i++)
+            if(is_variable_instruction(code[i].string))
+                for(int k = 0; k < count; k++)
+                    if(strncmp(names[k], code[i + 1].string, NAME_SIZE) == 0) code[i].slot = k;
+
+        frame[start] = count;
+    }
+
+    for(int i = 0; i < elements; i++)
+        if(strncmp(code[i].string, "call", D) == 0 && code[i].match != -1)
+            code[i].slot = frame[code[i].match - 1];
+
+    return valid;
+}
+
+int top_value(struct stack *stack, float *value){ //Reads the element on top of the stack
+    if(stack->size == 0) return 0;
+
+    *value = stack->values[stack->size - 1];
+
+    return 1;
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Coroutines section - #################################################
+
+#define COROUTINES 65536 //Defines the maximum number of coroutines alive at the same time
+#define COROUTINE_LOOPS 32 //The registers of a coroutine are smaller than the ones of the main program
+#define COROUTINE_CALLS 256
+#define COROUTINE_FRAMES 4096
+
+/*The registers of the running code are kept in a context: the main program has one and every coroutine has its own.
+Resume and yield save the position of the running context and load the position and the stack of the other,
+without copying anything else. The contexts of the ended coroutines are reused, with their handle, by the next cocreate*/
+struct context{
+    int pc; //Position of the last executed instruction
+    struct stack stack; //The array is kept when the context is reused
+    struct loop *loops; //The registers of the running loops
+    int loop_top, loop_floor, loop_depth;
+    struct call *calls; //The return addresses
+    float *frames; //The local variables of the running calls
+    int call_top, frames_top, call_depth, frames_size;
+    struct context *caller; //The context that resumed the coroutine, NULL while it's suspended
+    int handle;
+    int alive;
+    struct context *next_free;
+};
+
+struct{
+    struct context **table; //The context of every handle, 0 is the main program
+    int count;
+    struct context *free; //The contexts of the ended coroutines
+}coroutines;
+
+struct context *new_context(int loop_depth, int call_depth, int frames_size){
+    struct context *c = arena_alloc(&program_arena, sizeof(struct context));
+
+    memset(c, 0, sizeof(struct context));
+    c->loops = arena_alloc(&program_arena, loop_depth * sizeof(struct loop));
+    c->calls = arena_alloc(&program_arena, call_depth * sizeof(struct call));
+    c->frames = arena_alloc(&program_arena, frames_size * sizeof(float));
+    c->loop_depth = loop_depth;
+    c->call_depth = call_depth;
+    c->frames_size = frames_size;
+    c->alive = 1;
+
+    return c;
+}
+
+int cocreate(int start, float *handle){ //Prepares a coroutine that starts after the label at position start, 0 if there are too many
+    struct context *c = coroutines.free;
+
+    if(c != NULL)
+        coroutines.free = c->next_free;
+    else{
+        if(coroutines.count == COROUTINES) return 0;
+        if(coroutines.table == NULL){
+            coroutines.table = arena_alloc(&program_arena, COROUTINES * sizeof(struct context *));
+            coroutines.count = 1;
+        }
+        c = new_context(COROUTINE_LOOPS, COROUTINE_CALLS, COROUTINE_FRAMES);
+        c->handle = coroutines.count;
+        coroutines.table[coroutines.count++] = c;
+    }
+
+    c->pc = start;
+    c->stack.size = 0;
+    c->loop_top = c->loop_floor = c->call_top = c->frames_top = 0;
+    c->caller = NULL;
+    c->alive = 1;
+    *handle = c->handle;
+
+    return 1;
+}
+
+struct context *coroutine(float handle){ //The coroutine with the given handle, NULL if it doesn't exist or it has ended
+    int k = handle;
+
+    if(k != handle || k < 1 || k >= coroutines.count || !coroutines.table[k]->alive) return NULL;
+    return coroutines.table[k];
+}
+
+void end_coroutine(struct context *c){ //Empties the stack of the coroutine and makes its context reusable
+    clear(&c->stack);
+    c->alive = 0;
+    c->next_free = coroutines.free;
+    coroutines.free = c;
+}
+
+int pop_value(struct stack *stack, float *value){ //Reads and removes the element on top of the stack
+    return top_value(stack, value) && pop(stack);
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Record and replay section - ##########################################
+
+#define INPUT_IN 0
+#define INPUT_INCHAR 1
+#define INPUT_SEED 2
+
+/*The record is a text file with a line for every value read by in and inchar and for every seed used by randint,
+in the order they were used. The replay loads it before the run, so the inputs come from memory without waiting
+for the terminal and the random numbers are the same of the recorded run*/
+struct{
+    FILE *record;
+    int *kinds; //The kind of every replayed value, NULL without a replay
+    double *values;
+    int count;
+    int next;
+    int recorded;
+    long long input_ns; //Time spent waiting for the inputs
+}io;
+
+int replay_init(char filename[]){
+    FILE *fp = fopen(filename, "r");
+    char kind[16];
+    double value;
+    int lines = 0;
+
+    if(fp == NULL) return 0;
+    while(fscanf(fp, "%15s %lf", kind, &value) == 2) lines++;
+
+    io.kinds = arena_alloc(&program_arena, (lines + 1) * sizeof(int));
+    io.values = arena_alloc(&program_arena, (lines + 1) * sizeof(double));
+    rewind(fp);
+    while(io.count < lines && fscanf(fp, "%15s %lf", kind, &value) == 2){
+        if(strncmp(kind, "in", D) == 0) io.kinds[io.count] = INPUT_IN;
+        else if(strncmp(kind, "inchar", D) == 0) io.kinds[io.count] = INPUT_INCHAR;
+        else if(strncmp(kind, "seed", D) == 0) io.kinds[io.count] = INPUT_SEED;
+        else{
+            fclose(fp);
+            return 0;
         }
+        io.values[io.count++] = value;
+    }
+
+    fclose(fp);
+    return 1;
+}
+
+void record_value(int kind, double value){
+    char *names[] = {"in", "inchar", "seed"};
 
+    if(io.record == NULL) return;
+
+    fprintf(io.record, "%s %.17g\n", names[kind], value);
+    io.recorded++;
+}
+
+int replay_value(int kind, double *value){ //Takes the next recorded value, which must be of the requested kind
+    if(io.next == io.count || io.kinds[io.next] != kind) return 0;
+
+    *value = io.values[io.next++];
+    return 1;
+}
+
+int read_input(struct stack *stack, int code){ //Reads the value of in (code 0) or inchar (code 1), 0 if there's no value
+    long long start = now_ns();
+    double value;
+    float top;
+
+    if(io.kinds != NULL){
+        if(!replay_value(code == 0 ? INPUT_IN : INPUT_INCHAR, &value)) return 0;
+        push(stack, value);
+    }
+    else if(!in(stack, code))
+        return 0;
+
+    if(top_value(stack, &top)) record_value(code == 0 ? INPUT_IN : INPUT_INCHAR, top);
+    input_values++;
+    io.input_ns += now_ns() - start;
+    return 1;
+}
+
+int next_seed(unsigned int *seed){ //The seed of randint, the current time unless it's replayed
+    double value;
+
+    if(io.kinds == NULL) *seed = time(0);
+    else if(replay_value(INPUT_SEED, &value)) *seed = value;
+    else return 0;
+
+    record_value(INPUT_SEED, *seed);
+    return 1;
+}
+
+int replay_mismatch(token code[], int i){
+    printf("ERROR 16: The replay doesn't contain the value requested at line %d\n", code[i].line);
+    return 16;
+}
+
+int input_missing(token code[], int i){ //Reports why in or inchar didn't get their value
+    if(expired) return limit_exceeded(code, i);
+    if(io.kinds != NULL) return replay_mismatch(code, i);
+
+    printf("ERROR 19: The input ended before the value requested at line %d\n", code[i].line);
+    return 19;
+}
+
+int input_ended(){ //Checks if only spaces are left in the input, or in the replay
+    int c;
+
+    if(io.kinds != NULL){
+        for(int k = io.next; k < io.count; k++)
+            if(io.kinds[k] != INPUT_SEED) return 0;
+        return 1;
     }
 
-    clear(&stack); //Clears the stack
-    clear(&varstack); //Same but for the var stack
-    free(stack);
-    free(varstack);
+    while((c = getchar()) != EOF && isspace(c));
+    if(c == EOF) return 1;
+
+    ungetc(c, stdin);
+    return 0;
+}
+
+void print_io_times(long long run_ns){ //Splits the time of the run between the execution and the inputs
+    fflush(stdout);
+    fprintf(stderr, "\nexecution: %.3f ms, input: %.3f ms, %d values %s\n", (run_ns - io.input_ns) / 1e6, io.input_ns / 1e6,
+            io.kinds != NULL ? io.next : io.recorded, io.kinds != NULL ? "replayed" : "recorded");
+}
 
+//################################# - end of the section - #################################################
+
+int initial_debug(token code[], int elements){ //Checks if the if are declared correctly
+    int *if_stack = arena_alloc(&program_arena, (elements + 1) * sizeof(int)); //An enormous file doesn't fit the C stack
+    int *endif_stack = arena_alloc(&program_arena, (elements + 1) * sizeof(int));
+
+    int if_top = 0;
+    for(int i = 0; i < elements; i++){
+        if(strncmp(code[i].string, "ifeq", D) == 0 || strncmp(code[i].string, "ifdif", D) == 0 || strncmp(code[i].string, "ifgr", D) == 0 || strncmp(code[i].string, "iflw", D) == 0 || strncmp(code[i].string, "iftrue", D) == 0 || strncmp(code[i].string, "iffalse", D) == 0){
+            if_stack[if_top++] = code[i].line;
+        }
+        if(strncmp(code[i].string, "endif", D) == 0 && if_top >= 0){
+            if_top--;
+        }
+    }
+    int endif_top = 0;
+    for(int i = elements; i > 0; i--){ //The tokens are scrolled from the end to obtain the same result as for the if cycles
+        if(strncmp(code[i].string, "endif", D) == 0){
+            endif_stack[endif_top++] = code[i].line;
+        }
+
+        if((strncmp(code[i].string, "ifeq", D) == 0 || strncmp(code[i].string, "ifdif", D) == 0 || strncmp(code[i].string, "ifgr", D) == 0 || strncmp(code[i].string, "iflw", D) == 0 || strncmp(code[i].string, "iftrue", D) == 0 || strncmp(code[i].string, "iffalse", D) == 0) && endif_top > -1){
+            endif_top--;
+        }
+    }
+
+    for(int i = 0; i < if_top; i++){
+        printf("ERROR 9: The if at line %d is missing its counter part\n", if_stack[i]);
+    }
+
+    for(int i = endif_top - 1; i >= 0; i--){ //To print the errors in the correct order it's necessary to navigate the endif_stack backwards
+        printf("ERROR 9: The endif at line %d is missing its counter part\n", endif_stack[i]);
+    }
+
+    if(if_top < 0 || endif_top < 0) return 0;
+    return 1;
+}
+
+int valid_extension(char filename[]){ //Checks if the file extension is valid
+    char extension[5];
+
+    int len = strlen(filename);
+    if(len <= 4) return 0;
+
+    int j = 0;
+    for(int i = len - 4; i < len; i++)
+        extension[j++] = filename[i];
+    extension[j] = '\0';
+
+    if(strncmp(extension, ".fsn", 5) == 0) return 1;
+
+    return 0; 
+}
+
+//################################# - Modules section - ####################################################
+
+void set_token(token *t, char string[], int line, int file){
+    t->string = string;
+    t->line = line;
+    t->match = -1;
+    t->slot = -1;
+    t->file = file;
+    t->shared = -1;
+}
+
+/*Turns the file into an array of tokens. The lexing starts at first_line, inside a comment if comment is set, and
+leaves in comment the state at the end of the file. When state isn't NULL it receives the state at the beginning
+of every line: 0 in the code, 1 inside a comment and 2 inside a string*/
+token *lex(FILE *fp, int file, int first_line, int *comment, char state[], int *elements){
+    char line[D], carriage = '\0';
+    int count = 0, pos = 0, filled = first_line - 1;
+
+    //This cycle counts the number of tokens that will compose the array of strings
+    while(sfscanf(fp, line, D, &pos, &carriage) != EOF)
+        count++;
+    pos = first_line;
+    carriage = '\0'; //The state left by the first scan would count the last new line again
+
+    token *code = arena_alloc(&program_arena, (count + 1) * sizeof(token)); //The extra token holds the final halt
+    fseek(fp, 0, SEEK_SET); //Restores the original file pointer's position
+
+    int i = 0;
+    while(sfscanf(fp, line, D, &pos, &carriage) != EOF){ //Copies all of the tokens inside the array of strings
+        int start = pos;
+
+        for(char *c = line; *c != '\0'; c++) if(*c == '\n') pos++; //A string can continue on the next lines
+        if(state != NULL){
+            while(filled < start) state[++filled - first_line] = *comment;
+            while(filled < pos) state[++filled - first_line] = 2;
+        }
+
+        if(strncmp(line, "-->", D) == 0) *comment = 1;
+        else if(strncmp(line, "<--", D) == 0) *comment = 0;
+        else if(!*comment) set_token(&code[i++], pool_string(line), start, file);
+    }
+    if(state != NULL) while(filled < pos) state[++filled - first_line] = *comment;
+
+    set_token(&code[i], "halt", pos, file);
+    *elements = i; //The comments are not part of the program
+    return code;
+}
+
+token *read_source(FILE *fp, int file, int *elements){
+    int comment = 0;
+
+    return lex(fp, file, 1, &comment, NULL, elements);
+}
+
+void find_labels(struct module *m){
+    m->labels = arena_alloc(&program_arena, (m->elements + 1) * sizeof(int));
+    m->label_count = 0;
+
+    for(int i = 0; i + 1 < m->elements; i++)
+        if(strncmp(m->code[i].string, "label", D) == 0) m->labels[m->label_count++] = i;
+}
+
+int read_cache(struct module *m, char name[], struct stat *st){
+    char magic[sizeof(CACHE_MAGIC)];
+    long long mtime, nsec, size;
+    int file = m - modules, valid = 1;
+    FILE *fp = fopen(name, "rb");
+
+    if(fp == NULL) return 0;
+
+    if(fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+       fread(&mtime, sizeof(mtime), 1, fp) != 1 || fread(&nsec, sizeof(nsec), 1, fp) != 1 || fread(&size, sizeof(size), 1, fp) != 1 ||
+       mtime != (long long)st->st_mtim.tv_sec || nsec != (long long)st->st_mtim.tv_nsec || size != (long long)st->st_size ||
+       fread(&m->elements, sizeof(int), 1, fp) != 1 || fread(&m->label_count, sizeof(int), 1, fp) != 1){
+        fclose(fp);
+        return 0; //The cache is missing or it's older than the source
+    }
+
+    m->code = arena_alloc(&program_arena, (m->elements + 1) * sizeof(token));
+    m->labels = arena_alloc(&program_arena, (m->label_count + 1) * sizeof(int));
+
+    for(int i = 0; i <= m->elements && valid; i++){
+        int line, len;
+
+        if(fread(&line, sizeof(int), 1, fp) != 1 || fread(&len, sizeof(int), 1, fp) != 1 || len < 0 || len >= D){
+            valid = 0;
+            break;
+        }
+        char *string = arena_alloc(&string_arena, len + 1);
+        valid = fread(string, 1, len, fp) == (size_t)len;
+        string[len] = '\0';
+        set_token(&m->code[i], string, line, file);
+    }
+    if(valid) valid = fread(m->labels, sizeof(int), m->label_count, fp) == (size_t)m->label_count;
+
+    fclose(fp);
+    return valid;
+}
+
+void write_cache(struct module *m, char name[], struct stat *st){ //The cache is only an help, if it can't be written nothing happens
+    long long mtime = st->st_mtim.tv_sec, nsec = st->st_mtim.tv_nsec, size = st->st_size;
+    FILE *fp = fopen(name, "wb");
+
+    if(fp == NULL) return;
+
+    fwrite(CACHE_MAGIC, sizeof(CACHE_MAGIC), 1, fp);
+    fwrite(&mtime, sizeof(mtime), 1, fp);
+    fwrite(&nsec, sizeof(nsec), 1, fp); //Two saves in the same second differ only in the nanoseconds
+    fwrite(&size, sizeof(size), 1, fp);
+    fwrite(&m->elements, sizeof(int), 1, fp);
+    fwrite(&m->label_count, sizeof(int), 1, fp);
+    for(int i = 0; i <= m->elements; i++){
+        int len = strlen(m->code[i].string);
+
+        fwrite(&m->code[i].line, sizeof(int), 1, fp);
+        fwrite(&len, sizeof(int), 1, fp);
+        fwrite(m->code[i].string, 1, len, fp);
+    }
+    fwrite(m->labels, sizeof(int), m->label_count, fp);
+    fclose(fp);
+}
+
+int load_module(char path[], int line){ //Returns the index of the module, or -1 if the file can't be included
+    char real[PATH_MAX], name[PATH_MAX + 1];
+    struct stat st;
+    FILE *fp;
+
+    if(!valid_extension(path)){
+        printf("ERROR 10: The extension of the file included at line %d is not valid\n", line);
+        return -1;
+    }
+    if(realpath(path, real) == NULL || stat(real, &st) != 0){
+        printf("ERROR 2: The file included at line %d does not exist\n", line);
+        return -1;
+    }
+
+    for(int i = 0; i < module_count; i++)
+        if(strncmp(modules[i].path, real, PATH_MAX) == 0) return i;
+
+    if(module_count == MODULES){
+        printf("ERROR 14: Too many included files, line %d\n", line);
+        return -1;
+    }
+
+    struct module *m = &modules[module_count++];
+    strcpy(m->path, real);
+    m->linked = 0;
+    snprintf(name, sizeof(name), "%sc", real);
+
+    if(!read_cache(m, name, &st)){
+        if((fp = fopen(real, "r")) == NULL){
+            printf("ERROR 2: The file included at line %d does not exist\n", line);
+            return -1;
+        }
+        m->code = read_source(fp, m - modules, &m->elements);
+        fclose(fp);
+        find_labels(m);
+        write_cache(m, name, &st);
+    }
+
+    return m - modules;
+}
+
+int include_path(struct module *m, token *arg, char path[]){ //Builds the path of the included file, relative to the file that includes it
+    int len = strlen(arg->string);
+    char *slash = strrchr(m->path, '/');
+
+    if(len < 2 || arg->string[0] != '"' || arg->string[len - 1] != '"') return 0;
+
+    if(arg->string[1] == '/' || slash == NULL)
+        snprintf(path, PATH_MAX, "%.*s", len - 2, arg->string + 1);
+    else
+        snprintf(path, PATH_MAX, "%.*s/%.*s", (int)(slash - m->path), m->path, len - 2, arg->string + 1);
+    return 1;
+}
+
+int load_includes(int index){ //Loads all the files included by the module, directly or not
+    for(int i = 0; i + 1 < modules[index].elements; i++){
+        token *code = modules[index].code;
+        char path[PATH_MAX];
+
+        if(strncmp(code[i].string, "include", D) != 0) continue;
+
+        if(!include_path(&modules[index], &code[i + 1], path)){
+            printf("ERROR 6: The argument at line %d is not a string\n", code[i].line);
+            return 6;
+        }
+
+        int before = module_count;
+        int included = load_module(path, code[i].line);
+        if(included == -1) return 2;
+        if(included >= before && load_includes(included) != 0) return 2;
+    }
+
+    return 0;
+}
+
+int compare_strings(const void *a, const void *b){
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+int referenced(char *names[], int count, char name[]){
+    return bsearch(&name, names, count, sizeof(char *), compare_strings) != NULL;
+}
+
+//Copies the module in the program (only counts the tokens if program is NULL), replacing the includes with the included modules
+void splice(int index, token program[], int *count, char *names[], int name_count){
+    struct module *m = &modules[index];
+    int next_label = 0;
+
+    m->linked = 1;
+    for(int i = 0; i < m->elements; i++){
+        if(next_label < m->label_count && m->labels[next_label] == i){
+            next_label++;
+            if(index != 0 && !referenced(names, name_count, m->code[i + 1].string)){ //Nothing can reach the label
+                i++;
+                continue;
+            }
+        }
+
+        if(i + 1 < m->elements && strncmp(m->code[i].string, "include", D) == 0){
+            char path[PATH_MAX], real[PATH_MAX];
+
+            include_path(m, &m->code[i + 1], path);
+            realpath(path, real);
+            for(int j = 0; j < module_count; j++)
+                if(!modules[j].linked && strncmp(modules[j].path, real, PATH_MAX) == 0) splice(j, program, count, names, name_count);
+            i++;
+            continue;
+        }
+
+        if(program != NULL) program[*count] = m->code[i];
+        (*count)++;
+    }
+}
+
+int compare_labels(const void *a, const void *b){ //Orders the labels by name and then by position
+    const token *x = *(token **)a, *y = *(token **)b;
+    int c = strcmp(x[1].string, y[1].string);
+
+    return c != 0 ? c : (x > y) - (x < y);
+}
+
+//Connects every goto to the first label with its name, sorted holds the positions of the labels already ordered or is NULL
+void link_gotos(token code[], int elements, int sorted[], int count){
+    token **labels = arena_alloc(&program_arena, (elements + 1) * sizeof(token *));
+
+    if(sorted != NULL)
+        for(int i = 0; i < count; i++) labels[i] = &code[sorted[i]];
+    else{
+        count = 0;
+        for(int i = 0; i + 1 < elements; i++)
+            if(strncmp(code[i].string, "label", D) == 0) labels[count++] = &code[i];
+        qsort(labels, count, sizeof(token *), compare_labels);
+    }
+
+    for(int i = 0; i + 1 < elements; i++){
+        if(strncmp(code[i].string, "goto", D) != 0) continue;
+
+        int low = 0, high = count; //Searches the first label with the name
+        while(low < high){
+            int mid = (low + high) / 2;
+            if(strcmp(labels[mid][1].string, code[i + 1].string) < 0) low = mid + 1;
+            else high = mid;
+        }
+        if(low < count && strcmp(labels[low][1].string, code[i + 1].string) == 0)
+            code[i].match = labels[low] - code + 1;
+    }
+}
+
+int uses_label(char string[]){ //The instructions that reach a label by its name
+    return strncmp(string, "goto", D) == 0 || strncmp(string, "call", D) == 0 || strncmp(string, "cocreate", D) == 0;
+}
+
+int link_program(char filename[], token **program, int *elements){ //Builds the program from the file and its includes
+    FILE *fp = fopen(filename, "r");
+    int result, count = 0, name_count = 0;
+
+    if(fp == NULL){
+        printf("ERROR 2: The file does not exist\n");
+        return 2;
+    }
+
+    struct module *m = &modules[module_count++];
+    if(realpath(filename, m->path) == NULL) strncpy(m->path, filename, PATH_MAX - 1);
+    if(watch.code != NULL){ //The tokens kept by the watch mode are copied, the linker writes in them
+        m->elements = watch.elements;
+        m->code = arena_alloc(&program_arena, (m->elements + 1) * sizeof(token));
+        memcpy(m->code, watch.code, (m->elements + 1) * sizeof(token));
+    }
+    else
+        m->code = read_source(fp, 0, &m->elements);
+    fclose(fp);
+    find_labels(m);
+
+    if((result = load_includes(0)) != 0) return result;
+
+    if(module_count == 1){ //Without includes the file is already the whole program
+        *program = m->code;
+        *elements = m->elements;
+        if(watch.code != NULL) link_gotos(*program, *elements, watch.labels, watch.label_count);
+        else link_gotos(*program, *elements, NULL, 0);
+        return 0;
+    }
+
+    for(int i = 0; i < module_count; i++) //Collects the names used by goto, call and cocreate
+        for(int j = 0; j + 1 < modules[i].elements; j++)
+            if(uses_label(modules[i].code[j].string)) name_count++;
+
+    char **names = arena_alloc(&program_arena, (name_count + 2) * sizeof(char *));
+    name_count = 0;
+    for(int i = 0; i < module_count; i++)
+        for(int j = 0; j + 1 < modules[i].elements; j++)
+            if(uses_label(modules[i].code[j].string)) names[name_count++] = modules[i].code[j + 1].string;
+    if(options.reduce) names[name_count++] = options.reduce; //The run that merges the shards starts from it
+    qsort(names, name_count, sizeof(char *), compare_strings);
+
+    splice(0, NULL, &count, names, name_count);
+    for(int i = 0; i < module_count; i++) modules[i].linked = 0;
+
+    *program = arena_alloc(&program_arena, (count + 1) * sizeof(token));
+    *elements = 0;
+    splice(0, *program, elements, names, name_count);
+    set_token(&(*program)[*elements], "halt", m->code[m->elements].line, 0);
+
+    link_gotos(*program, *elements, NULL, 0);
+    return 0;
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Shared variables section - ###########################################
+
+#define SHARED_VARS 4096 //Defines the number of variables of a shared memory segment
+
+/*The variables declared with shvar live in the POSIX shared memory segment named by --shm, so every process that
+maps the same segment sees the same values. The segment is a table addressed by the hash of the names: a process
+claims a free entry with a compare and swap, writes the name and then publishes it, so the processes that declare the
+same name always reach the same entry. The values are kept as the bits of their float, which lets load, store,
+fetchadd and cas be atomic. The segment stays in /dev/shm after the processes end, until it's removed*/
+struct shared_var{
+    atomic_int state; //0 free, 1 while the name is written, 2 ready
+    char name[NAME_SIZE];
+    atomic_uint bits;
+};
+
+struct{
+    struct shared_var *vars; //The mapped segment
+    struct shared_var **bound; //The entry of every name declared with shvar, NULL until its shvar runs
+    int count; //Number of names declared with shvar
+}shm;
+
+int is_shared_instruction(char string[]){
+    return strncmp(string, "shvar", D) == 0 || strncmp(string, "fetchadd", D) == 0 || strncmp(string, "cas", D) == 0;
+}
+
+int shm_map(char name[]){ //Maps the segment, creating it the first time
+    char path[NAME_MAX + 1];
+    size_t size = SHARED_VARS * sizeof(struct shared_var);
+    struct stat st;
+    int fd;
+
+    snprintf(path, sizeof(path), "/%s", name);
+    if((fd = shm_open(path, O_RDWR | O_CREAT, 0600)) == -1) return 0;
+    if(fstat(fd, &st) == -1 || (st.st_size < (off_t)size && ftruncate(fd, size) == -1)){ //The new segment is filled with zeros
+        close(fd);
+        return 0;
+    }
+
+    shm.vars = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(shm.vars == MAP_FAILED){
+        shm.vars = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+int link_shared(token code[], int elements){ //Numbers the names declared with shvar and connects their instructions to them
+    char **names = arena_alloc(&program_arena, (elements + 1) * sizeof(char *));
+    int valid = 1;
+
+    shm.count = 0;
+    for(int i = 0; i + 1 < elements; i++){
+        if(strncmp(code[i].string, "shvar", D) != 0) continue;
+
+        if(options.shm == NULL && !options.emit_c){
+            printf("ERROR 20: The shared variable at line %d needs the --shm option\n", code[i].line);
+            valid = 0;
+        }
+        int k = 0;
+        while(k < shm.count && strncmp(names[k], code[i + 1].string, NAME_SIZE) != 0) k++;
+        if(k == shm.count) names[shm.count++] = code[i + 1].string;
+    }
+
+    for(int i = 0; i + 1 < elements; i++){
+        char *op = code[i].string;
+        int k = 0;
+
+        if(!(is_variable_instruction(op) && code[i].slot == -1) && !is_shared_instruction(op)) continue; //The locals come first
+
+        while(k < shm.count && strncmp(names[k], code[i + 1].string, NAME_SIZE) != 0) k++;
+        if(k < shm.count) code[i].shared = k;
+        else if(is_shared_instruction(op)){
+            printf("ERROR 20: The variable at line %d is not shared\n", code[i].line);
+            valid = 0;
+        }
+    }
+
+    shm.bound = arena_alloc(&program_arena, (shm.count + 1) * sizeof(struct shared_var *));
+    memset(shm.bound, 0, (shm.count + 1) * sizeof(struct shared_var *));
+    return valid;
+}
+
+struct shared_var *shared_entry(char name[]){ //The entry of the name, claimed if it's new. NULL if the segment is full
+    unsigned int hash = 5381;
+
+    for(int c = 0; c < NAME_SIZE - 1 && name[c] != '\0'; c++) hash = hash * 33 + (unsigned char)name[c];
+
+    for(int n = 0; n < SHARED_VARS; n++){
+        struct shared_var *v = &shm.vars[(hash + n) % SHARED_VARS];
+        int free = 0;
+
+        if(atomic_compare_exchange_strong(&v->state, &free, 1)){
+            strncpy(v->name, name, NAME_SIZE - 1);
+            atomic_store(&v->state, 2);
+            return v;
+        }
+        while(atomic_load(&v->state) == 1); //Another process is writing the name
+        if(strncmp(v->name, name, NAME_SIZE - 1) == 0) return v;
+    }
+    return NULL;
+}
+
+float bits_float(unsigned int bits){
+    float value;
+
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+unsigned int float_bits(float value){
+    unsigned int bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+float shared_add(struct shared_var *v, float n){ //Adds n to the variable, returns the value it had before
+    unsigned int old = atomic_load(&v->bits);
+
+    while(!atomic_compare_exchange_weak(&v->bits, &old, float_bits(bits_float(old) + n)));
+    return bits_float(old);
+}
+
+int shared_cas(struct shared_var *v, float expected, float desired){ //Stores desired if the variable holds expected, 1 if it did
+    unsigned int old = atomic_load(&v->bits);
+
+    while(bits_float(old) == expected)
+        if(atomic_compare_exchange_weak(&v->bits, &old, float_bits(desired))) return 1;
+    return 0;
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Optimizer section - ##################################################
+
+/*The optimizer runs on every instruction when its block is translated, the first time the run reaches it, and writes
+in the tokens the shortcuts it finds, without changing what the program does, errors included:
+- every if gets the position of its endif, so a false condition doesn't have to search it
+- an if whose body is only a goto takes the jump itself
+- a counting loop, a label with a backward goto right after the inc or dec of the counter on top of the stack, jumps
+  back from the inc. When the loop starts with an if, which compares the counter with the limit below it, the inc does
+  that comparison too, so every iteration costs its body and a single instruction
+- the loads inside a loop remember the variable they found until a del changes the variables, the value is still
+  read at every load because the loop can store it
+The fused jumps skip instructions, so they're left out when an instrument has to see every instruction*/
+struct binding{
+    node var; //NULL until the load finds its variable
+    unsigned int generation; //The var_generation when the variable was found
+};
+
+struct{
+    struct binding *bindings; //The match of a load inside a loop is its position here
+    int count;
+    int capacity;
+}optimizer;
+
+int is_if_instruction(char string[]){
+    return strncmp(string, "ifeq", D) == 0 || strncmp(string, "ifdif", D) == 0 || strncmp(string, "ifgr", D) == 0 ||
+           strncmp(string, "iflw", D) == 0 || strncmp(string, "iftrue", D) == 0 || strncmp(string, "iffalse", D) == 0;
+}
+
+void bind_loads(token code[], int elements, int start, int end){ //Numbers the loads of global variables between start and end
+    int changes = 0; //The vars and dels inside the loop
+
+    for(int i = start; i < end; i++)
+        if(strncmp(code[i].string, "var", D) == 0 || strncmp(code[i].string, "del", D) == 0) changes++;
+
+    for(int i = start; i < end; i += 1 + has_argument(code, elements, i)){
+        int changed = 0;
+
+        if(strncmp(code[i].string, "load", D) != 0 || code[i].slot != -1 || code[i].shared != -1 || code[i].match != -1 || i + 1 >= elements) continue;
+
+        for(int j = start; changes > 0 && j + 1 < end; j++) //A variable declared or deleted by the loop isn't remembered
+            if((strncmp(code[j].string, "var", D) == 0 || strncmp(code[j].string, "del", D) == 0) &&
+               strncmp(code[j + 1].string, code[i + 1].string, NAME_SIZE) == 0) changed = 1;
+        if(changed) continue;
+
+        if(optimizer.count == optimizer.capacity){ //Doubles the bindings, the old array stays in the arena until the end of the run
+            int capacity = optimizer.capacity ? optimizer.capacity * 2 : 64;
+            struct binding *bindings = arena_alloc(&program_arena, capacity * sizeof(struct binding));
+
+            memset(bindings, 0, capacity * sizeof(struct binding));
+            if(optimizer.count > 0) memcpy(bindings, optimizer.bindings, optimizer.count * sizeof(struct binding));
+            optimizer.bindings = bindings;
+            optimizer.capacity = capacity;
+        }
+        code[i].match = optimizer.count++;
+    }
+}
+
+int endif_of(token code[], int elements, int i){ //The endif of the if at i, searched the first time it's needed
+    if(code[i].match == -1) code[i].match = next_valid_instruction(code, elements, i);
+    return code[i].match;
+}
+
+void optimize(token code[], int elements, int i){ //Writes the shortcuts of the instruction at i
+    char *op = code[i].string;
+    int jumps = i + 1 < elements && strncmp(code[i + 1].string, "goto", D) == 0 && code[i + 1].match != -1;
+
+    if(is_if_instruction(op)) endif_of(code, elements, i);
+    else if(strncmp(op, "goto", D) == 0 && code[i].match != -1 && code[i].match < i)
+        bind_loads(code, elements, code[i].match, i);
+    else if((strncmp(op, "repeat", D) == 0 || strncmp(op, "while", D) == 0) && code[i].match > i)
+        bind_loads(code, elements, i, code[i].match);
+
+    if(instrumented || options.coverage) return;
+
+    if(is_if_instruction(op) && jumps && code[i].match == i + 3)
+        code[i].slot = code[i + 1].match; //The if only contains the goto
+    else if((strncmp(op, "inc", D) == 0 || strncmp(op, "dec", D) == 0) && jumps && code[i + 1].match < i){
+        int head = code[i + 1].match + 1; //The first instruction of the loop
+
+        code[i].match = code[i + 1].match;
+        if(head < elements && is_if_instruction(code[head].string) && endif_of(code, elements, head) > i + 2) code[i].slot = head; //The goto is inside the if
+    }
+}
+
+int back_jump(token code[], int i, struct stack *stack){ //Where the loop continues after the inc or dec at i
+    int head = code[i].slot, result;
+
+    if(head == -1) return code[i].match;
+
+    result = loop_condition(code[head].string + 2, stack); //The condition of the if without its prefix
+    if(result == -1) return code[i].match; //The if reports the missing elements
+    return result == 1 ? head : code[head].match;
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Translation to C section - ###########################################
+
+/*The translation writes a C program that behaves exactly like the interpreter, errors included: the stack is a fixed
+array, every variable is a local of main, the instructions reached by a jump get a C label and the ifs become
+conditional jumps to their endif. The runtime functions below are the same ones the interpreter uses*/
+#define C_STACK_SIZE 1048576 //The STACK_SIZE of the runtime below
+
+char c_runtime[] =
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <math.h>\n"
+    "#include <time.h>\n"
+    "#include <string.h>\n"
+    "#include <ctype.h>\n"
+    "#include <limits.h>\n"
+    "\n"
+    "#define STACK_SIZE 1048576\n"
+    "#define LOOP_DEPTH 256\n"
+    "#define CALL_DEPTH 4096\n"
+    "#define FRAMES_SIZE 65536\n"
+    "#define FAIL(code, message) do{ printf(\"%s\", message); return code; }while(0)\n"
+    "#define NEED(n, code, message) if(sp < n) FAIL(code, message)\n"
+    "#define PUSH(v) do{ if(sp == STACK_SIZE) FAIL(11, \"ERROR 11: Out of memory\\n\"); s[sp] = (v); sp++; }while(0)\n"
+    "\n"
+    "struct loop{\n"
+    "    int start;\n"
+    "    long remaining;\n"
+    "    long index;\n"
+    "};\n"
+    "\n"
+    "struct call{\n"
+    "    int ret;\n"
+    "    int base;\n"
+    "    int loop_floor;\n"
+    "};\n"
+    "\n"
+    "static float s[STACK_SIZE];\n"
+    "static int sp = 0;\n"
+    "static float frames[FRAMES_SIZE];\n"
+    "static long long start_ns;\n"
+    "\n"
+    "static long long now_ns(){\n"
+    "    struct timespec ts;\n"
+    "\n"
+    "    clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+    "    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;\n"
+    "}\n"
+    "\n"
+    "static float in(int code, int clear, int line){\n"
+    "    float input;\n"
+    "    char c, character;\n"
+    "    int valid;\n"
+    "\n"
+    "    while(1){\n"
+    "        if(code == 0)\n"
+    "            valid = scanf(\"%f\", &input);\n"
+    "        else if(code == 1){\n"
+    "            valid = scanf(\" %c\", &character);\n"
+    "            input = character;\n"
+    "        }\n"
+    "\n"
+    "        if(valid == 1) break;\n"
+    "        if(valid == EOF){\n"
+    "            printf(\"ERROR 19: The input ended before the value requested at line %d\\n\", line);\n"
+    "            exit(19);\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    if(clear) while((c = getchar()) != '\\n' && c != EOF);\n"
+    "    return input;\n"
+    "}\n"
+    "\n"
+    "static unsigned int float_key(float v){\n"
+    "    unsigned int k;\n"
+    "\n"
+    "    memcpy(&k, &v, sizeof(k));\n"
+    "    return k & 0x80000000u ? ~k : k | 0x80000000u;\n"
+    "}\n"
+    "\n"
+    "static int compare_floats(const void *a, const void *b){\n"
+    "    unsigned int x = float_key(*(const float *)a), y = float_key(*(const float *)b);\n"
+    "\n"
+    "    return (x > y) - (x < y);\n"
+    "}\n"
+    "\n"
+    "static void sort(int n, int mode){ /* 0 ascending, 1 descending, 2 unique */\n"
+    "    float *t = s + sp - n, v;\n"
+    "    int kept = 0;\n"
+    "\n"
+    "    qsort(t, n, sizeof(float), compare_floats);\n"
+    "    if(mode == 1)\n"
+    "        for(int k = 0; k < n / 2; k++){ v = t[k]; t[k] = t[n - 1 - k]; t[n - 1 - k] = v; }\n"
+    "    if(mode == 2){\n"
+    "        for(int k = 0; k < n; k++)\n"
+    "            if(kept == 0 || float_key(t[k]) != float_key(t[kept - 1])) t[kept++] = t[k];\n"
+    "        sp -= n - kept;\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static int input_ended(){\n"
+    "    int c;\n"
+    "\n"
+    "    while((c = getchar()) != EOF && isspace(c));\n"
+    "    if(c == EOF) return 1;\n"
+    "\n"
+    "    ungetc(c, stdin);\n"
+    "    return 0;\n"
+    "}\n"
+    "\n"
+    "static void printlist(){\n"
+    "    if(sp == 0){\n"
+    "        printf(\"\\nEMPTY\\n\");\n"
+    "        return;\n"
+    "    }\n"
+    "\n"
+    "    printf(\"\\n|\");\n"
+    "    for(int i = 0; i < sp; i++) printf(\"%.3f|\", s[i]);\n"
+    "    printf(\"<-top\\n\");\n"
+    "}\n"
+    "\n";
+
+void emit_string(char string[]){ //Prints the string as a C literal
+    putchar('"');
+    for(unsigned char *c = (unsigned char *)string; *c != '\0'; c++){
+        if(*c == '"' || *c == '\\') printf("\\%c", *c);
+        else if(*c == '\n') printf("\\n");
+        else if(*c < ' ' || *c > '~') printf("\\%03o", *c);
+        else putchar(*c);
+    }
+    putchar('"');
+}
+
+void emit_fail(char condition[], int code, char message[], int line){ //The message contains the %d of the line
+    char text[D];
+
+    snprintf(text, D, message, line);
+    if(condition != NULL) printf("    if(%s) ", condition);
+    else printf("    ");
+    printf("FAIL(%d, ", code);
+    emit_string(text);
+    printf(");\n");
+}
+
+char *c_condition(char cond[]){ //The C version of the if and while conditions, the second element is s[sp - 2]
+    if(strncmp(cond, "ifeq", D) == 0 || strncmp(cond, "eq", D) == 0) return "s[sp - 1] == s[sp - 2]";
+    if(strncmp(cond, "ifdif", D) == 0 || strncmp(cond, "dif", D) == 0) return "s[sp - 1] != s[sp - 2]";
+    if(strncmp(cond, "ifgr", D) == 0 || strncmp(cond, "gr", D) == 0) return "s[sp - 2] > s[sp - 1]";
+    if(strncmp(cond, "iflw", D) == 0 || strncmp(cond, "lw", D) == 0) return "s[sp - 2] < s[sp - 1]";
+    if(strncmp(cond, "iftrue", D) == 0 || strncmp(cond, "true", D) == 0) return "s[sp - 1] == 1";
+    if(strncmp(cond, "iffalse", D) == 0 || strncmp(cond, "false", D) == 0) return "s[sp - 1] == 0";
+    return NULL;
+}
+
+int c_condition_size(char cond[]){ //The elements needed by the condition
+    return strstr(cond, "true") != NULL || strstr(cond, "false") != NULL ? 1 : 2;
+}
+
+int c_variable(char *names[], int count, char name[]){ //The number of the C local that holds the variable
+    for(int k = 0; k < count; k++)
+        if(strncmp(names[k], name, NAME_SIZE) == 0) return k;
+    return -1;
+}
+
+int is_sort_instruction(char string[]){
+    return strncmp(string, "sort", D) == 0 || strncmp(string, "rsort", D) == 0 || strncmp(string, "usort", D) == 0;
+}
+
+int is_index_instruction(char string[]){ //The instructions that take the distance from the top as an optional argument
+    return strncmp(string, "pick", D) == 0 || strncmp(string, "roll", D) == 0 || strncmp(string, "drop", D) == 0;
+}
+
+int has_argument(token code[], int elements, int i){ //Checks if the instruction at position i is followed by an argument
+    char *op = code[i].string;
+
+    if(strncmp(op, "repeat", D) == 0 || is_sort_instruction(op) || is_index_instruction(op)) return repeat_literal(code, elements, i);
+    if(strncmp(op, "var", D) == 0) return i + 1 < elements;
+    return strncmp(op, "push", D) == 0 || strncmp(op, "print", D) == 0 || strncmp(op, "printnl", D) == 0 ||
+           is_variable_instruction(op) || strncmp(op, "del", D) == 0 || strncmp(op, "randint", D) == 0 ||
+           strncmp(op, "label", D) == 0 || strncmp(op, "local", D) == 0 || strncmp(op, "goto", D) == 0 ||
+           strncmp(op, "call", D) == 0 || strncmp(op, "while", D) == 0 || is_timing_instruction(op) || strncmp(op, "cocreate", D) == 0 ||
+           is_shared_instruction(op);
+}
+
+int is_coroutine_instruction(char string[]){ //The coroutines aren't translated, the program stops when it reaches them
+    return strncmp(string, "cocreate", D) == 0 || strncmp(string, "resume", D) == 0 || strncmp(string, "yield", D) == 0;
+}
+
+int c_jumps(token code[], int elements, int i, int to[]){ //Finds where the instruction at position i can jump, -1 if it never continues to the next one
+    char *op = code[i].string;
+    int start = code[i].match;
+
+    if(strncmp(op, "if", 2) == 0 && c_condition(op) != NULL) to[0] = next_valid_instruction(code, elements, i) + 1;
+    else if(strncmp(op, "call", D) == 0 || strncmp(op, "repeat", D) == 0 || strncmp(op, "while", D) == 0) to[0] = start + 1;
+    else if(strncmp(op, "endrepeat", D) == 0) to[0] = repeat_literal(code, elements, start) ? start + 2 : start + 1;
+    else if(strncmp(op, "endwhile", D) == 0) to[0] = start + 2;
+    else if(strncmp(op, "goto", D) == 0){
+        if(start == -1) return -1;
+        to[0] = start + 1;
+        return -1;
+    }
+    else if(strncmp(op, "ret", D) == 0 || strncmp(op, "halt", D) == 0 || is_coroutine_instruction(op) || is_shared_instruction(op)) return -1;
+    else return 0;
+
+    return 1;
+}
+
+void emit_c(token code[], int elements, char filename[]){
+    char *target = arena_alloc(&program_arena, elements + 3); //Marks the positions reached by a jump
+    char *reached = arena_alloc(&program_arena, elements + 3); //Dead code, like the blocks skipped by a goto, is left out
+    int *pending = arena_alloc(&program_arena, (elements + 3) * sizeof(int));
+    char **names = arena_alloc(&program_arena, (elements + 1) * sizeof(char *));
+    int name_count = 0, calls = 0, rets = 0, top = 0;
+    char *empty = "ERROR 4: The stack is empty, line %d\n";
+    char *two = "ERROR 5: The stack is composed of less than 2 elements, line %d\n";
+    char *invalid = "ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n";
+    char *loop_size = "ERROR 5: The stack doesn't contain enough elements, line %d\n";
+    char *iterations = "ERROR 3: The number of iterations is not valid, line %d\n";
+    char *missing = "ERROR 7: The variable at line %d doesn't exists\n";
+    char check[D];
+
+    memset(target, 0, elements + 3);
+    memset(reached, 0, elements + 3);
+    reached[0] = 1;
+    pending[top++] = 0;
+    while(top > 0){ //Follows every path of the program from the first instruction
+        int i = pending[--top], to[1];
+        int jumps = c_jumps(code, elements, i, to);
+        int next = i + 1 + has_argument(code, elements, i);
+
+        if(jumps == -1) next = -1;
+        if(jumps != 0 && to[0] <= elements){
+            target[to[0]] = 1;
+            if(!reached[to[0]]) reached[pending[top++] = to[0]] = 1;
+        }
+        if(next != -1 && next < elements && !reached[next]) reached[pending[top++] = next] = 1;
+    }
+
+    for(int i = 0; i < elements; i++){ //Finds the global variables and the arguments reached by a jump
+        char *op = code[i].string;
+        int to[1];
+
+        if(reached[i] && has_argument(code, elements, i) && reached[i + 1] && c_jumps(code, elements, i, to) != -1) target[i + 2] = 1;
+
+        if(i + 1 < elements && ((is_variable_instruction(op) && code[i].slot == -1 && code[i].shared == -1) || strncmp(op, "var", D) == 0 || strncmp(op, "del", D) == 0))
+            if(c_variable(names, name_count, code[i + 1].string) == -1) names[name_count++] = code[i + 1].string;
+    }
+
+    printf("/* Translated by fsnail from ");
+    for(char *c = filename; *c != '\0'; c++) if(*c != '*') putchar(*c);
+    printf(" */\n");
+    fputs(c_runtime, stdout);
+    printf("int main(){\n");
+    for(int k = 0; k < name_count; k++){
+        printf("    float v%d = 0; //", k);
+        for(char *c = names[k]; *c != '\0' && c - names[k] < NAME_SIZE; c++) putchar(*c == '\\' ? '/' : *c);
+        printf("\n    int d%d = 0;\n", k);
+    }
+    printf("    struct loop loops[LOOP_DEPTH];\n");
+    printf("    int loop_top = 0, loop_floor = 0;\n");
+    printf("    struct call calls[CALL_DEPTH];\n");
+    printf("    int call_top = 0, frames_top = 0;\n");
+    for(int k = 0; k < timing.count; k++) printf("    long long m%d = -1;\n", k);
+    printf("    start_ns = now_ns();\n\n");
+
+    for(int i = 0; i < elements; i++){
+        char *op = code[i].string;
+        char *arg = i + 1 < elements ? code[i + 1].string : "";
+        int line = code[i].line, skip = has_argument(code, elements, i);
+        int var = c_variable(names, name_count, arg);
+
+        if(!reached[i]) continue;
+        if(target[i]) printf("p%d:;\n", i);
+        printf("    //line %d: %s\n", line, op);
+
+        if(strncmp(op, "push", D) == 0){
+            if(i + 1 < elements){
+                if(real_number(arg)){
+                    float value = atof(arg);
+                    printf("    PUSH((float)%a);\n", value);
+                }
+                else
+                    emit_fail(NULL, 3, "ERROR 3: The argument at line %d is not a number\n", line);
+            }
+        }
+        else if(strncmp(op, "pop", D) == 0){
+            emit_fail("sp < 1", 4, empty, line);
+            printf("    sp--;\n");
+        }
+        else if(strncmp(op, "dup", D) == 0){
+            emit_fail("sp < 1", 4, empty, line);
+            printf("    PUSH(s[sp - 1]);\n");
+        }
+        else if(strncmp(op, "clear", D) == 0 || strncmp(op, "vclear", D) == 0)
+            printf("    sp = 0;\n");
+        else if(strncmp(op, "swap", D) == 0){
+            emit_fail("sp < 2", 5, two, line);
+            printf("    { float t = s[sp - 2]; s[sp - 2] = s[sp - 1]; s[sp - 1] = t; }\n");
+        }
+        else if(strncmp(op, "over", D) == 0){
+            emit_fail("sp < 2", 5, two, line);
+            printf("    PUSH(s[sp - 2]);\n");
+        }
+        else if(strncmp(op, "rot", D) == 0){
+            emit_fail("sp < 3", 5, loop_size, line);
+            printf("    { float t = s[sp - 3]; s[sp - 3] = s[sp - 2]; s[sp - 2] = s[sp - 1]; s[sp - 1] = t; }\n");
+        }
+        else if(is_index_instruction(op)){
+            if(skip)
+                printf("    { float n = %a;\n", (float)atof(arg));
+            else{
+                emit_fail("sp < 1", 4, empty, line);
+                printf("    { float n = s[--sp];\n");
+            }
+            emit_fail(op[0] == 'd' ? "!(n >= 0 && n <= sp)" : "!(n >= 0 && n < sp)", 5, loop_size, line); //A NaN fails them too
+            if(op[0] == 'p') printf("    PUSH(s[sp - 1 - (int)n]); }\n");
+            else if(op[0] == 'd') printf("    sp -= (int)n; }\n");
+            else printf("    int k = n; float t = s[sp - 1 - k]; memmove(&s[sp - 1 - k], &s[sp - k], k * sizeof(float)); s[sp - 1] = t; }\n");
+        }
+        else if(strncmp(op, "depth", D) == 0)
+            printf("    PUSH((float)sp);\n");
+        else if(strncmp(op, "sum", D) == 0 || strncmp(op, "sub", D) == 0 || strncmp(op, "mult", D) == 0){
+            emit_fail("sp < 2", 5, two, line);
+            printf("    s[sp - 2] = s[sp - 2] %c s[sp - 1];\n    sp--;\n", op[0] == 'm' ? '*' : op[2] == 'm' ? '+' : '-');
+        }
+        else if(strncmp(op, "div", D) == 0 || strncmp(op, "rem", D) == 0){
+            emit_fail("sp < 2 || s[sp - 1] == 0", 5, invalid, line);
+            if(op[0] == 'd') printf("    s[sp - 2] = s[sp - 2] / s[sp - 1];\n    sp--;\n");
+            else printf("    { int a = s[sp - 2], b = s[sp - 1]; s[sp - 2] = a %% b; }\n    sp--;\n");
+        }
+        else if(strncmp(op, "toint", D) == 0 || strncmp(op, "inc", D) == 0 || strncmp(op, "dec", D) == 0){
+            emit_fail("sp < 1", 5, invalid, line);
+            if(op[0] == 't') printf("    { int a = s[sp - 1]; s[sp - 1] = a; }\n");
+            else printf("    s[sp - 1] = s[sp - 1] %c 1;\n", op[0] == 'i' ? '+' : '-');
+        }
+        else if(strncmp(op, "and", D) == 0 || strncmp(op, "or", D) == 0 || strncmp(op, "xor", D) == 0){
+            emit_fail("sp < 2", 5, two, line);
+            printf("    { int a = s[sp - 2], b = s[sp - 1]; s[sp - 2] = a %c b; }\n    sp--;\n", op[0] == 'a' ? '&' : op[0] == 'o' ? '|' : '^');
+        }
+        else if(strncmp(op, "not", D) == 0 || strncmp(op, "lshift", D) == 0 || strncmp(op, "rshift", D) == 0){
+            emit_fail("sp < 2", 5, two, line);
+            printf("    { int a = s[sp - 1]; s[sp - 1] = %s; }\n", op[0] == 'n' ? "~a" : op[0] == 'l' ? "a << 1" : "a >> 1");
+        }
+        else if(strncmp(op, "print", D) == 0 || strncmp(op, "printnl", D) == 0){
+            if(i + 1 < elements){
+                int len = strlen(arg);
+                char temp[len + 2];
+
+                if(arg[0] == '"' && arg[len - 1] == '"'){
+                    prepare_string(arg, len, temp);
+                    if(op[5] == 'n') strcat(temp, "\n");
+                    printf("    fputs(");
+                    emit_string(temp);
+                    printf(", stdout);\n");
+                }
+                else
+                    emit_fail(NULL, 6, "ERROR 6: The argument at line %d is not a string\n", line);
+            }
+        }
+        else if(strncmp(op, "in", D) == 0 || strncmp(op, "inchar", D) == 0)
+            printf("    { float v = in(%d, sp > 0, %d); PUSH(v); }\n", op[2] == 'c', line);
+        else if(strncmp(op, "eof", D) == 0)
+            printf("    PUSH(input_ended());\n");
+        else if(strncmp(op, "out", D) == 0 || strncmp(op, "outint", D) == 0 || strncmp(op, "outchar", D) == 0){
+            emit_fail("sp < 1", 5, two, line);
+            if(op[3] == '\0') printf("    printf(\"%%.3f\", s[sp - 1]);\n");
+            else printf("    { int c = s[sp - 1]; printf(\"%%%c\", c); }\n", op[3] == 'i' ? 'd' : 'c');
+        }
+        else if(strncmp(op, "sclear", D) == 0)
+            printf("    printf(\"\\033[1;1H\\033[2J\");\n");
+        else if(strncmp(op, "if", 2) == 0 && c_condition(op) != NULL){
+            if(c_condition_size(op) == 1) emit_fail("sp < 1", 4, empty, line);
+            else emit_fail("sp < 2", 5, two, line);
+            printf("    if(!(%s)) goto p%d;\n", c_condition(op), next_valid_instruction(code, elements, i) + 1);
+        }
+        else if(strncmp(op, "endif", D) == 0 || strncmp(op, "label", D) == 0 || strncmp(op, "local", D) == 0);
+        else if(strncmp(op, "repeat", D) == 0){
+            if(skip){
+                long count = 0;
+
+                if(!iteration_count(atof(arg), &count)) emit_fail(NULL, 3, iterations, line); //The literal is checked while translating
+                printf("    { long count = %ld;\n", count);
+            }
+            else{
+                emit_fail("sp < 1", 4, empty, line);
+                emit_fail("!(s[sp - 1] >= (double)LONG_MIN && s[sp - 1] < -(double)LONG_MIN)", 3, iterations, line);
+                printf("    { long count = s[sp - 1];\n    sp--;\n");
+            }
+            printf("    while(loop_top > loop_floor && loops[loop_top - 1].start >= %d) loop_top--;\n", i);
+            printf("    if(count <= 0) goto p%d;\n", code[i].match + 1);
+            emit_fail("loop_top == LOOP_DEPTH", 12, "ERROR 12: Too many nested loops, line %d\n", line);
+            printf("    loops[loop_top].start = %d;\n    loops[loop_top].remaining = count;\n    loops[loop_top].index = 0;\n    loop_top++; }\n", i);
+        }
+        else if(strncmp(op, "endrepeat", D) == 0 || strncmp(op, "endwhile", D) == 0){
+            int start = code[i].match;
+            char message[D];
+
+            snprintf(message, D, "ERROR 12: The %s at line %%d is not inside a running loop\n", op);
+            printf("    while(loop_top > loop_floor && loops[loop_top - 1].start != %d) loop_top--;\n", start);
+            emit_fail("loop_top == loop_floor", 12, message, line);
+            if(op[3] == 'r')
+                printf("    if(--loops[loop_top - 1].remaining > 0){\n        loops[loop_top - 1].index++;\n        goto p%d;\n    }\n    loop_top--;\n", repeat_literal(code, elements, start) ? start + 2 : start + 1);
+            else{
+                snprintf(check, D, "sp < %d", c_condition_size(code[start + 1].string));
+                emit_fail(check, 5, loop_size, line);
+                printf("    if(%s){\n        loops[loop_top - 1].index++;\n        goto p%d;\n    }\n    loop_top--;\n", c_condition(code[start + 1].string), start + 2);
+            }
+        }
+        else if(strncmp(op, "while", D) == 0){
+            snprintf(check, D, "sp < %d", c_condition_size(arg));
+            emit_fail(check, 5, loop_size, line);
+            printf("    while(loop_top > loop_floor && loops[loop_top - 1].start >= %d) loop_top--;\n", i);
+            printf("    if(!(%s)) goto p%d;\n", c_condition(arg), code[i].match + 1);
+            emit_fail("loop_top == LOOP_DEPTH", 12, "ERROR 12: Too many nested loops, line %d\n", line);
+            printf("    loops[loop_top].start = %d;\n    loops[loop_top].remaining = 0;\n    loops[loop_top].index = 0;\n    loop_top++;\n", i);
+        }
+        else if(strncmp(op, "index", D) == 0){
+            emit_fail("loop_top == loop_floor", 12, "ERROR 12: The index at line %d is not inside a running loop\n", line);
+            printf("    PUSH(loops[loop_top - 1].index);\n");
+        }
+        else if(strncmp(op, "call", D) == 0){
+            snprintf(check, D, "call_top == CALL_DEPTH || frames_top + %d > FRAMES_SIZE", code[i].slot);
+            emit_fail(check, 13, "ERROR 13: Too many nested calls, line %d\n", line);
+            printf("    calls[call_top].ret = %d;\n    calls[call_top].base = frames_top;\n    calls[call_top].loop_floor = loop_floor;\n    call_top++;\n", calls);
+            printf("    for(int k = 0; k < %d; k++) frames[frames_top + k] = 0;\n    frames_top += %d;\n    loop_floor = loop_top;\n", code[i].slot, code[i].slot);
+            printf("    goto p%d;\nr%d:;\n", code[i].match + 1, calls++);
+        }
+        else if(strncmp(op, "ret", D) == 0){
+            emit_fail("call_top == 0", 13, "ERROR 13: The ret at line %d is not inside a call\n", line);
+            printf("    call_top--;\n    frames_top = calls[call_top].base;\n    loop_top = loop_floor;\n    loop_floor = calls[call_top].loop_floor;\n    goto ret;\n");
+            rets++;
+        }
+        else if(is_shared_instruction(op) || code[i].shared != -1)
+            emit_fail(NULL, 20, "ERROR 20: The shared variable at line %d can't be translated to C\n", line);
+        else if(is_variable_instruction(op) && code[i].slot != -1){
+            emit_fail("call_top == 0", 13, "ERROR 13: The local variable at line %d is used outside of a call\n", line);
+            if(op[0] == 'l') printf("    PUSH(frames[calls[call_top - 1].base + %d]);\n", code[i].slot);
+            else{
+                emit_fail("sp < 1", 4, empty, line);
+                printf("    frames[calls[call_top - 1].base + %d] = s[sp - 1];\n", code[i].slot);
+                if(op[0] == 'p') printf("    sp--;\n");
+            }
+        }
+        else if(strncmp(op, "goto", D) == 0){
+            if(code[i].match != -1) printf("    goto p%d;\n", code[i].match + 1);
+            else emit_fail(NULL, 6, "ERROR 6: The label at line %d doesn't exist\n", line);
+        }
+        else if(strncmp(op, "var", D) == 0){
+            if(i + 1 < elements) printf("    if(d%d++ == 0) v%d = 0;\n", var, var);
+        }
+        else if(is_variable_instruction(op) || strncmp(op, "del", D) == 0){
+            if(i + 1 < elements){
+                snprintf(check, D, "d%d == 0", var);
+                if(op[0] == 's' || op[0] == 'p') emit_fail("sp < 1", 4, empty, line);
+                emit_fail(check, 7, missing, line);
+                if(op[0] == 'l') printf("    PUSH(v%d);\n", var);
+                else if(op[0] == 'd') printf("    d%d--;\n    v%d = 0;\n", var, var);
+                else printf("    v%d = s[sp - 1];\n", var);
+            }
+            if(op[0] == 'p') printf("    if(sp > 0) sp--;\n");
+        }
+        else if(strncmp(op, "randint", D) == 0){
+            if(i + 1 < elements){
+                if(real_number(arg))
+                    printf("    { float n = (float)%a; int limit = n; srand(time(0)); PUSH((float)((rand() %% limit) + 1)); }\n", (float)atof(arg));
+                else
+                    emit_fail(NULL, 3, "ERROR 3: The argument at line %d is not a number\n", line);
+            }
+        }
+        else if(strncmp(op, "abs", D) == 0){
+            emit_fail("sp < 1", 4, empty, line);
+            printf("    if(s[sp - 1] < 0) s[sp - 1] *= (-1);\n");
+        }
+        else if(strncmp(op, "pow", D) == 0){
+            emit_fail("sp < 2", 5, two, line);
+            printf("    s[sp - 2] = powf(s[sp - 2], s[sp - 1]);\n    sp--;\n");
+        }
+        else if(strncmp(op, "ln", D) == 0 || strncmp(op, "log", D) == 0 || strncmp(op, "ceil", D) == 0 || strncmp(op, "logtwo", D) == 0 ||
+                strncmp(op, "sqrt", D) == 0 || strncmp(op, "sin", D) == 0 || strncmp(op, "cos", D) == 0 || strncmp(op, "tan", D) == 0){
+            char *function = op[0] == 'l' ? (op[1] == 'n' ? "logf" : op[3] == 't' ? "log2f" : "log10f") : op[0] == 'c' ? (op[1] == 'e' ? "ceilf" : "cosf") :
+                             op[0] == 's' ? (op[1] == 'q' ? "sqrtf" : "sinf") : "tanf";
+
+            emit_fail("sp < 1", 4, empty, line);
+            printf("    s[sp - 1] = %s(s[sp - 1]);\n", function);
+        }
+        else if(strncmp(op, "stack", D) == 0)
+            printf("    printlist();\n");
+        else if(is_sort_instruction(op)){
+            int mode = op[0] == 's' ? SORT_ASCENDING : op[0] == 'r' ? SORT_DESCENDING : SORT_UNIQUE;
+
+            if(!skip)
+                printf("    sort(sp, %d);\n", mode);
+            else if(!(atof(arg) >= 0))
+                emit_fail(NULL, 3, "ERROR 3: The argument at line %d is not a number\n", line);
+            else if(atof(arg) > C_STACK_SIZE) //No stack of the native program is that deep
+                emit_fail(NULL, 5, loop_size, line);
+            else{
+                snprintf(check, D, "sp < %d", (int)atof(arg));
+                emit_fail(check, 5, loop_size, line);
+                printf("    if(%d > 1) sort(%d, %d);\n", (int)atof(arg), (int)atof(arg), mode);
+            }
+        }
+        else if(strncmp(op, "clock", D) == 0)
+            printf("    PUSH((float)(now_ns() - start_ns));\n");
+        else if(is_timing_instruction(op)){
+            if(i + 1 < elements){
+                snprintf(check, D, "m%d == -1", code[i].slot);
+                if(op[0] == 'm') printf("    m%d = now_ns();\n", code[i].slot);
+                else emit_fail(check, 17, "ERROR 17: The mark at line %d has not been saved\n", line);
+                if(op[0] == 'e') printf("    PUSH((float)(now_ns() - m%d));\n", code[i].slot);
+                if(op[0] == 't'){
+                    printf("    fprintf(stderr, \"%%s %%lld\\n\", ");
+                    emit_string(arg);
+                    printf(", now_ns() - m%d);\n", code[i].slot);
+                }
+            }
+        }
+        else if(strncmp(op, "halt", D) == 0)
+            printf("    return 0;\n");
+        else if(is_coroutine_instruction(op))
+            emit_fail(NULL, 18, "ERROR 18: The coroutine at line %d can't be translated to C\n", line);
+        else
+            emit_fail(NULL, 8, "ERROR 8: Unknown token in line %d\n", line);
+
+        if(skip){ //The argument is reached only if a jump lands on it
+            if(!reached[i + 1])
+                i++;
+            else if(target[i + 2])
+                printf("    goto p%d;\n", i + 2);
+        }
+    }
+
+    for(int i = elements; i < elements + 3; i++) if(target[i]) printf("p%d:;\n", i);
+    printf("    return 0;\n");
+    if(rets > 0){ //Every ret jumps back to the instruction after its call
+        printf("ret:\n    switch(calls[call_top].ret){\n");
+        for(int k = 0; k < calls; k++) printf("    case %d: goto r%d;\n", k, k);
+        printf("    }\n    return 0;\n");
+    }
+    printf("}\n");
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Bytecode section - ###################################################
+
+/*The tokens are lexed and linked before the run, but an instruction becomes an opcode only when the run reaches its
+basic block for the first time: the block is translated up to the first instruction that can jump, the optimizer
+writes its shortcuts, and the opcodes stay for the rest of the run. The run then dispatches on the opcode instead of
+comparing the name, and the parts of a file that never run are never translated. The opcodes live in an array with a
+byte for every token, whose pages are given by the system only when a block in them is translated*/
+enum{
+    OP_NEW, //Not translated yet
+    OP_PUSH, OP_POP, OP_DUP, OP_CLEAR, OP_SWAP, OP_OVER, OP_ROT, OP_DEPTH, OP_SUM, OP_SUB, OP_MULT, OP_DIV, OP_REM, OP_TOINT,
+    OP_INC, OP_DEC, OP_AND, OP_OR, OP_NOT, OP_XOR, OP_LSHIFT, OP_RSHIFT,
+    OP_PRINT, OP_PRINTNL, OP_IN, OP_INCHAR, OP_EOF, OP_OUT, OP_OUTINT, OP_OUTCHAR, OP_SCLEAR,
+    OP_IFEQ, OP_IFDIF, OP_IFGR, OP_IFLW, OP_IFTRUE, OP_IFFALSE, OP_ENDIF, OP_LABEL, OP_GOTO,
+    OP_REPEAT, OP_ENDREPEAT, OP_WHILE, OP_ENDWHILE, OP_INDEX, OP_CALL, OP_RET, OP_LOCAL, OP_COCREATE, OP_RESUME, OP_YIELD,
+    OP_VAR, OP_DEL, OP_STORE, OP_PSTORE, OP_LOAD, OP_VCLEAR, OP_SHVAR, OP_RANDINT, OP_STACK, OP_HALT, OP_CLOCK, OP_MARK,
+    OP_ABS, OP_POW, OP_LN, OP_LOG, OP_LOGTWO, OP_CEIL, OP_SQRT, OP_SIN, OP_COS, OP_TAN,
+    OP_NAMED, //The opcodes above are found by their name alone
+    OP_PICK, //pick, roll and drop
+    OP_SORT, //sort, rsort and usort
+    OP_ELAPSED, //elapsed and timing
+    OP_SHARED, //load, store, pstore, fetchadd and cas of a shared variable
+    OP_LOCAL_VAR, //load, store and pstore of a local variable
+    OP_JUMP, //A goto whose label has been found by the linker
+    OP_UNKNOWN
+};
+
+#define OP_UNCOVERED 0x80 //Added to the opcodes of --coverage until their first execution
+
+char *opcode_names[OP_NAMED] = { //In the order of the opcodes
+    "",
+    "push", "pop", "dup", "clear", "swap", "over", "rot", "depth", "sum", "sub", "mult", "div", "rem", "toint",
+    "inc", "dec", "and", "or", "not", "xor", "lshift", "rshift",
+    "print", "printnl", "in", "inchar", "eof", "out", "outint", "outchar", "sclear",
+    "ifeq", "ifdif", "ifgr", "iflw", "iftrue", "iffalse", "endif", "label", "goto",
+    "repeat", "endrepeat", "while", "endwhile", "index", "call", "ret", "local", "cocreate", "resume", "yield",
+    "var", "del", "store", "pstore", "load", "vclear", "shvar", "randint", "stack", "halt", "clock", "mark",
+    "abs", "pow", "ln", "log", "logtwo", "ceil", "sqrt", "sin", "cos", "tan"
+};
+
+struct{
+    unsigned char *ops; //The opcode of every token, OP_NEW until its block is translated
+    int count; //Translated blocks
+    int translated; //Translated instructions
+}blocks;
+
+int opcode_of(token code[], int i){ //Uses the same order of the checks of the run
+    char *op = code[i].string;
+
+    if(code[i].shared != -1 && strncmp(op, "shvar", D) != 0) return OP_SHARED;
+    if(is_variable_instruction(op) && code[i].slot != -1) return OP_LOCAL_VAR;
+    if(strncmp(op, "goto", D) == 0 && code[i].match != -1) return OP_JUMP;
+    if(is_index_instruction(op)) return OP_PICK;
+    if(is_sort_instruction(op)) return OP_SORT;
+    if(strncmp(op, "elapsed", D) == 0 || strncmp(op, "timing", D) == 0) return OP_ELAPSED;
+
+    for(int k = 1; k < OP_NAMED; k++)
+        if(strncmp(op, opcode_names[k], D) == 0) return k;
+    return OP_UNKNOWN;
+}
+
+int ends_block(int op){ //The instructions that can continue somewhere else than the next one
+    return (op >= OP_IFEQ && op <= OP_YIELD && op != OP_ENDIF && op != OP_LABEL && op != OP_INDEX && op != OP_LOCAL) ||
+           op == OP_JUMP || op == OP_HALT; //The inc of a counting loop goes on to its goto, which numbers the loads of the loop
+}
+
+void blocks_init(int elements){
+    blocks.ops = calloc(elements + 1, 1); //The zeroed pages are only mapped, they cost nothing until they're written
+    if(blocks.ops == NULL){
+        printf("ERROR 11: Out of memory\n");
+        exit(11);
+    }
+    blocks.count = blocks.translated = 0;
+    optimizer.bindings = NULL;
+    optimizer.count = optimizer.capacity = 0;
+}
+
+void translate_block(token code[], int elements, int i){ //Translates from i to the end of the basic block
+    for(; i < elements && blocks.ops[i] == OP_NEW; i += 1 + has_argument(code, elements, i)){
+        int op = opcode_of(code, i);
+
+        optimize(code, elements, i);
+        blocks.ops[i] = options.coverage ? op | OP_UNCOVERED : op;
+        blocks.translated++;
+        if(ends_block(op)) break;
+    }
+    blocks.count++;
+}
+
+void first_visit(token code[], int elements, int i){ //The first execution of the instruction at i
+    if(blocks.ops[i] == OP_NEW) translate_block(code, elements, i); //The first time the run reaches the block
+    if(blocks.ops[i] & OP_UNCOVERED){
+        coverage.bits[i >> 6] |= 1ULL << (i & 63);
+        blocks.ops[i] &= ~OP_UNCOVERED;
+    }
+}
+
+void print_blocks(int elements){ //Part of the memory report
+    fprintf(stderr, "translated blocks: %d, %d instructions of %d tokens\n", blocks.count, blocks.translated, elements);
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Metrics section - ####################################################
+
+/*The metrics are counters cheap enough to be kept on every run: the run counts the executions of every opcode right
+before dispatching it, the shortcuts of the optimizer count the instructions they skip, and a few totals are updated
+where they happen. They're written in the file given with --metrics at the end of the run and, while it runs, when the
+process receives SIGUSR2. A name ending with .prom gets the text format read by the textfile collector of the
+Prometheus node exporter, any other name gets JSON. The file is written next to the old one and then renamed over
+it, so a reader never finds half of it*/
+struct{
+    long long opcodes[OP_UNKNOWN + 1]; //Executions of every opcode
+    long long false_ifs; //Ifs whose body was skipped
+    char *filename;
+}metrics;
+
+char *metric_names[] = { //The opcodes that share the code of several instructions, after OP_NAMED
+    "pick/roll/drop", "sort/rsort/usort", "elapsed/timing", "shared variable", "local variable", "goto", "unknown"
+};
+
+volatile sig_atomic_t metrics_requested = 0;
+
+void metrics_signal(int sig){
+    (void)sig;
+    metrics_requested = 1;
+}
+
+void metrics_init(char filename[]){
+    memset(metrics.opcodes, 0, sizeof(metrics.opcodes));
+    metrics.false_ifs = 0;
+    metrics.filename = filename;
+    output_bytes = input_values = 0;
+
+    signal(SIGUSR2, metrics_signal);
+}
+
+void count_back_jump(token code[], int elements, int i, int next){ //The goto and the if skipped by the inc or dec at i
+    int head = code[i].slot;
+
+    metrics.opcodes[OP_JUMP]++;
+    if(head == -1 || next == code[i].match) return; //The if runs by itself
+    if(blocks.ops[head] == OP_NEW) translate_block(code, elements, head);
+    metrics.opcodes[blocks.ops[head]]++;
+    if(next == code[head].match) metrics.false_ifs++;
+}
+
+void prom_label(FILE *fp, char s[]){ //Prints the value of a label escaping it like the text format wants
+    for(; *s != '\0'; s++){
+        if(*s == '\n') fputs("\\n", fp);
+        else{
+            if(*s == '\\' || *s == '"') fputc('\\', fp);
+            fputc(*s, fp);
+        }
+    }
+}
+
+void write_metrics(int status){ //The status is the exit code of the run, -1 while it's running
+    char temp[PATH_MAX + 8];
+    int length = strlen(options.metrics), prom = length > 5 && strcmp(options.metrics + length - 5, ".prom") == 0;
+    int distinct = 0; //The opcodes executed at least once
+    long long totals[OP_UNKNOWN + 1], instructions = 0, gotos = metrics.opcodes[OP_GOTO] + metrics.opcodes[OP_JUMP];
+    char *names[OP_UNKNOWN + 1];
+    FILE *fp;
+
+    for(int op = OP_PUSH; op <= OP_UNKNOWN; op++){
+        long long count = metrics.opcodes[op] + (op == OP_GOTO ? metrics.opcodes[OP_JUMP] : 0); //A linked goto is still a goto
+
+        instructions += metrics.opcodes[op];
+        if(count == 0 || op == OP_NAMED || op == OP_JUMP) continue;
+        names[distinct] = op < OP_NAMED ? opcode_names[op] : metric_names[op - OP_NAMED - 1];
+        totals[distinct++] = count;
+    }
+
+    struct{
+        char *name;
+        char *help;
+        long long value;
+    }values[] = {
+        {"instructions", "Instructions executed", instructions},
+        {"gotos", "Jumps done by goto", gotos},
+        {"false_ifs", "Ifs whose body was skipped", metrics.false_ifs},
+        {"peak_stack_depth", "Deepest stack reached", stack_peak},
+        {"variables", "Variables existing now", var_pool.live},
+        {"peak_variables", "Most variables existing at the same time", var_pool.peak},
+        {"output_bytes", "Bytes printed by the output instructions", output_bytes},
+        {"input_values", "Values read by in and inchar", input_values},
+    };
+    int count = sizeof(values) / sizeof(values[0]);
+    double seconds = (now_ns() - timing.start) / 1e9;
+
+    snprintf(temp, sizeof(temp), "%s.tmp", options.metrics);
+    if((fp = fopen(temp, "w")) == NULL){
+        fprintf(stderr, "The metrics file %s can't be written\n", options.metrics);
+        return;
+    }
+
+    if(prom){
+        for(int k = 0; k < count; k++){
+            int counter = strncmp(values[k].name, "peak", 4) != 0 && strncmp(values[k].name, "variables", D) != 0;
+
+            fprintf(fp, "# HELP fsnail_%s%s %s\n", values[k].name, counter ? "_total" : "", values[k].help);
+            fprintf(fp, "# TYPE fsnail_%s%s %s\n", values[k].name, counter ? "_total" : "", counter ? "counter" : "gauge");
+            fprintf(fp, "fsnail_%s%s{program=\"", values[k].name, counter ? "_total" : "");
+            prom_label(fp, metrics.filename);
+            fprintf(fp, "\"} %lld\n", values[k].value);
+        }
+        fprintf(fp, "# HELP fsnail_opcode_executions_total Executions of every instruction\n");
+        fprintf(fp, "# TYPE fsnail_opcode_executions_total counter\n");
+        for(int k = 0; k < distinct; k++){
+            fprintf(fp, "fsnail_opcode_executions_total{program=\"");
+            prom_label(fp, metrics.filename);
+            fprintf(fp, "\",opcode=\"");
+            prom_label(fp, names[k]);
+            fprintf(fp, "\"} %lld\n", totals[k]);
+        }
+        fprintf(fp, "# HELP fsnail_seconds Time since the start of the run\n# TYPE fsnail_seconds gauge\nfsnail_seconds{program=\"");
+        prom_label(fp, metrics.filename);
+        fprintf(fp, "\"} %.6f\n", seconds);
+        fprintf(fp, "# HELP fsnail_running 1 while the program runs\n# TYPE fsnail_running gauge\nfsnail_running{program=\"");
+        prom_label(fp, metrics.filename);
+        fprintf(fp, "\"} %d\n", status == -1);
+        if(status != -1){
+            fprintf(fp, "# HELP fsnail_exit_code Exit code of the run\n# TYPE fsnail_exit_code gauge\nfsnail_exit_code{program=\"");
+            prom_label(fp, metrics.filename);
+            fprintf(fp, "\"} %d\n", status);
+        }
+    }
+    else{
+        fprintf(fp, "{\n  \"program\": ");
+        json_string(fp, metrics.filename);
+        fprintf(fp, ",\n  \"running\": %s,\n", status == -1 ? "true" : "false");
+        if(status != -1) fprintf(fp, "  \"exit_code\": %d,\n", status);
+        fprintf(fp, "  \"seconds\": %.6f,\n", seconds);
+        for(int k = 0; k < count; k++) fprintf(fp, "  \"%s\": %lld,\n", values[k].name, values[k].value);
+        fprintf(fp, "  \"opcodes\": {");
+        for(int k = 0; k < distinct; k++){
+            fprintf(fp, "%s\n    ", k > 0 ? "," : "");
+            json_string(fp, names[k]);
+            fprintf(fp, ": %lld", totals[k]);
+        }
+        fprintf(fp, "%s}\n}\n", distinct > 0 ? "\n  " : "");
+    }
+
+    fclose(fp);
+    if(rename(temp, options.metrics) != 0) fprintf(stderr, "The metrics file %s can't be written\n", options.metrics);
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Checkpoint section - #################################################
+
+#define CHECKPOINT_MAGIC "FSNCP1"
+#define CHECKPOINT_EVERY 1000000 //Defines the steps between two snapshots when --every isn't given
+
+/*With --checkpoint the run saves a snapshot every --every steps, the same jumps counted by --max-steps. The step
+only forks the process: the copy finishes the jump, writes at the next instruction the position, the stack, the
+variables, the registers of the loops and calls, the position in the replay and the hash of the program, and ends.
+The pages are shared by the two processes until one of them writes, so the run goes on while the snapshot is written.
+A step that finds the previous copy still writing skips its snapshot, and the runs with coroutines aren't saved.
+The snapshot is written next to the old one and renamed over it, so a crash never leaves half of it. --restore
+checks the hash and resumes from the saved instruction*/
+struct{
+    unsigned long long hash; //FNV-1a of the tokens of the program
+    pid_t writer; //The process writing the last snapshot
+    node *varstack; //The registers of the run, read by the copy
+    struct context **cx;
+}checkpoint;
+
+unsigned long long program_hash(token code[], int elements){
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for(int i = 0; i < elements; i++)
+        for(unsigned char *c = (unsigned char *)code[i].string; ; c++){
+            hash = (hash ^ *c) * 1099511628211ULL;
+            if(*c == '\0') break; //The terminators keep the tokens apart
+        }
+
+    return hash;
+}
+
+void checkpoint_schedule(){ //The next step checked by the jumps
+    step_limit = options.max_steps;
+    if(options.checkpoint && steps + options.every < step_limit) step_limit = steps + options.every;
+}
+
+int checkpoint_step(){ //Called when the steps reach step_limit, 0 if the program has to stop
+    pid_t pid;
+
+    if(expired || steps > options.max_steps || options.checkpoint == NULL) return 0;
+
+    checkpoint_schedule();
+    if(checkpoint.writer > 0){
+        if(waitpid(checkpoint.writer, NULL, WNOHANG) == 0) return 1; //The previous snapshot isn't ready yet
+        checkpoint.writer = 0;
+    }
+    if(coroutines.count > 0) return 1;
+
+    fflush(NULL); //The copy ends with _exit, but the buffers mustn't be written twice by other ways
+    if((pid = fork()) == 0){
+        checkpoint_writing = 1;
+        instrumented = 1; //The snapshot is written by the instrument, once the jump is done
+    }
+    else if(pid > 0)
+        checkpoint.writer = pid;
+
+    return 1;
+}
+
+void write_checkpoint(int pc, struct stack *stack){
+    char temp[PATH_MAX + 8];
+    struct context *cx = *checkpoint.cx;
+    int count = 0, next = io.kinds != NULL ? io.next : 0;
+    FILE *fp;
+
+    snprintf(temp, sizeof(temp), "%s.tmp", options.checkpoint);
+    if((fp = fopen(temp, "wb")) == NULL) _exit(1);
+
+    for(node v = *checkpoint.varstack; v != NULL; v = v->next) count++;
+
+    fwrite(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC), 1, fp);
+    fwrite(&checkpoint.hash, sizeof(checkpoint.hash), 1, fp);
+    fwrite(&pc, sizeof(int), 1, fp);
+    fwrite(&steps, sizeof(steps), 1, fp);
+    fwrite(&next, sizeof(int), 1, fp);
+
+    fwrite(&stack->size, sizeof(int), 1, fp);
+    fwrite(stack->values, sizeof(float), stack->size, fp);
+
+    fwrite(&count, sizeof(int), 1, fp);
+    for(node v = *checkpoint.varstack; v != NULL; v = v->next){
+        fwrite(v->name, NAME_SIZE, 1, fp);
+        fwrite(&v->value, sizeof(float), 1, fp);
+    }
+
+    fwrite(&cx->loop_top, sizeof(int), 1, fp);
+    fwrite(&cx->loop_floor, sizeof(int), 1, fp);
+    fwrite(cx->loops, sizeof(struct loop), cx->loop_top, fp);
+    fwrite(&cx->call_top, sizeof(int), 1, fp);
+    fwrite(&cx->frames_top, sizeof(int), 1, fp);
+    fwrite(cx->calls, sizeof(struct call), cx->call_top, fp);
+    fwrite(cx->frames, sizeof(float), cx->frames_top, fp);
+
+    if(fclose(fp) != 0 || rename(temp, options.checkpoint) != 0) _exit(1);
+    _exit(0);
+}
+
+int restore_checkpoint(int elements, int *pc, struct stack *stack, node *varstack, struct context *cx){
+    FILE *fp = fopen(options.restore, "rb");
+    char magic[sizeof(CHECKPOINT_MAGIC)], name[NAME_SIZE + 1] = {0};
+    unsigned long long hash;
+    int next, size, count, valid;
+    float value;
+
+    valid = fp != NULL && fread(magic, sizeof(magic), 1, fp) == 1 && memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) == 0 &&
+            fread(&hash, sizeof(hash), 1, fp) == 1;
+    if(valid && hash != checkpoint.hash){
+        printf("ERROR 21: The checkpoint %s was saved by a different program\n", options.restore);
+        fclose(fp);
+        return 21;
+    }
+
+    valid = valid && fread(pc, sizeof(int), 1, fp) == 1 && *pc >= 0 && *pc < elements && fread(&steps, sizeof(steps), 1, fp) == 1 &&
+            fread(&next, sizeof(int), 1, fp) == 1 && fread(&size, sizeof(int), 1, fp) == 1 && size >= 0;
+    for(int k = 0; valid && k < size; k++){
+        if((valid = fread(&value, sizeof(float), 1, fp) == 1)) push(stack, value);
+    }
+
+    valid = valid && fread(&count, sizeof(int), 1, fp) == 1;
+    for(int k = 0; valid && k < count; k++){
+        if((valid = fread(name, NAME_SIZE, 1, fp) == 1 && fread(&value, sizeof(float), 1, fp) == 1)) new_var(varstack, name)->value = value;
+    }
+
+    valid = valid && fread(&cx->loop_top, sizeof(int), 1, fp) == 1 && fread(&cx->loop_floor, sizeof(int), 1, fp) == 1 &&
+            cx->loop_top >= 0 && cx->loop_top <= cx->loop_depth && cx->loop_floor >= 0 && cx->loop_floor <= cx->loop_top &&
+            fread(cx->loops, sizeof(struct loop), cx->loop_top, fp) == (size_t)cx->loop_top &&
+            fread(&cx->call_top, sizeof(int), 1, fp) == 1 && fread(&cx->frames_top, sizeof(int), 1, fp) == 1 &&
+            cx->call_top >= 0 && cx->call_top <= cx->call_depth && cx->frames_top >= 0 && cx->frames_top <= cx->frames_size &&
+            fread(cx->calls, sizeof(struct call), cx->call_top, fp) == (size_t)cx->call_top &&
+            fread(cx->frames, sizeof(float), cx->frames_top, fp) == (size_t)cx->frames_top;
+
+    if(fp != NULL) fclose(fp);
+    if(!valid){
+        printf("ERROR 2: The checkpoint file does not exist or is not valid\n");
+        return 2;
+    }
+
+    if(io.kinds != NULL) io.next = next; //The replay goes on from the same value
+    return 0;
+}
+
+//################################# - end of the section - #################################################
+
+char *parse_options(int argc, char *argv[]){ //Reads the options and returns the name of the file to run
+    char *filename = NULL;
+
+    for(int i = 1; i < argc; i++){
+        if(strncmp(argv[i], "--mem-stats", D) == 0)
+            options.mem_stats = 1;
+        else if(strncmp(argv[i], "--profile", D) == 0)
+            options.profile = 1;
+        else if(strncmp(argv[i], "--sample", D) == 0)
+            options.sample = 1;
+        else if(strncmp(argv[i], "--emit-c", D) == 0)
+            options.emit_c = 1;
+        else if(strncmp(argv[i], "--trace", D) == 0 && i + 1 < argc){
+            if((options.trace = atoi(argv[++i])) <= 0) return NULL;
+        }
+        else if(strncmp(argv[i], "--max-steps", D) == 0 && i + 1 < argc){
+            if((options.max_steps = atoll(argv[++i])) <= 0) return NULL;
+        }
+        else if(strncmp(argv[i], "--timeout", D) == 0 && i + 1 < argc){
+            if((options.timeout = atoi(argv[++i])) <= 0) return NULL;
+        }
+        else if(strncmp(argv[i], "--record", D) == 0 && i + 1 < argc)
+            options.record = argv[++i];
+        else if(strncmp(argv[i], "--replay", D) == 0 && i + 1 < argc)
+            options.replay = argv[++i];
+        else if(strncmp(argv[i], "--watch", D) == 0)
+            options.watch = 1;
+        else if(strncmp(argv[i], "--timings", D) == 0 && i + 1 < argc)
+            options.timings = argv[++i];
+        else if(strncmp(argv[i], "--coverage", D) == 0 && i + 1 < argc)
+            options.coverage = argv[++i];
+        else if(strncmp(argv[i], "--shard", D) == 0 && i + 1 < argc){
+            if((options.shard = atoi(argv[++i])) <= 0) return NULL;
+        }
+        else if(strncmp(argv[i], "--reduce", D) == 0 && i + 1 < argc)
+            options.reduce = argv[++i];
+        else if(strncmp(argv[i], "--shm", D) == 0 && i + 1 < argc)
+            options.shm = argv[++i];
+        else if(strncmp(argv[i], "--metrics", D) == 0 && i + 1 < argc)
+            options.metrics = argv[++i];
+        else if(strncmp(argv[i], "--checkpoint", D) == 0 && i + 1 < argc)
+            options.checkpoint = argv[++i];
+        else if(strncmp(argv[i], "--every", D) == 0 && i + 1 < argc){
+            if((options.every = atoll(argv[++i])) <= 0) return NULL;
+        }
+        else if(strncmp(argv[i], "--restore", D) == 0 && i + 1 < argc)
+            options.restore = argv[++i];
+        else if(strncmp(argv[i], "--perf-counters", D) == 0)
+            options.perf_counters = 1;
+        else if(strncmp(argv[i], "--perf-classes", D) == 0)
+            options.perf_counters = options.perf_classes = 1;
+        else if(strncmp(argv[i], "--", 2) == 0)
+            return NULL;
+        else if(filename == NULL)
+            filename = argv[i];
+        else
+            return NULL;
+    }
+
+    return filename;
+}
+
+int run(token code[], int elements);
+
+int execute(char filename[]){ //Links and runs the program once
+    int elements, result;
+    token *code;
+
+    if((result = link_program(filename, &code, &elements)) != 0) return result;
+
+    int valid = initial_debug(code, elements);
+    valid = loop_debug(code, elements) && valid;
+    if(!link_subroutines(code, elements)) return 6;
+    if(!valid) return 9;
+    link_marks(code, elements);
+    if(!link_shared(code, elements)) return 20;
+
+    if(options.emit_c){ //The program is translated instead of being run
+        emit_c(code, elements, filename);
+        return 0;
+    }
+
+    if(options.profile){
+        profile_init(code, elements);
+        instrumented = 1;
+    }
+    if(options.trace){
+        trace_init();
+        instrumented = 1;
+    }
+    if(options.sample){
+        sample_init(elements);
+        instrumented = 1;
+    }
+    if(options.coverage) coverage_init(elements);
+    if(options.metrics) metrics_init(filename);
+    if(options.perf_classes) instrumented = 1;
+    blocks_init(elements);
+    if(shm.count > 0 && shm.vars == NULL && !shm_map(options.shm)){
+        printf("ERROR 2: The shared memory segment can't be opened\n");
+        return 2;
+    }
+    if(options.max_steps == 0) options.max_steps = LLONG_MAX;
+    if(options.every == 0) options.every = CHECKPOINT_EVERY;
+    steps = 0;
+    expired = 0;
+    if(options.timeout) watchdog_init();
+    memset(&io, 0, sizeof(io));
+    if(options.replay && !replay_init(options.replay)){
+        printf("ERROR 2: The replay file does not exist or is not valid\n");
+        return 2;
+    }
+    if(options.record && (io.record = fopen(options.record, "w")) == NULL){
+        printf("ERROR 2: The record file can't be created\n");
+        return 2;
+    }
+    timing.out = stderr;
+    if(options.timings && (timing.out = fopen(options.timings, "w")) == NULL){
+        printf("ERROR 2: The timings file can't be created\n");
+        return 2;
+    }
+
+    if(options.perf_counters) perf_init(code, elements); //Without the events the run goes on and the report says why
+
+    long long start = timing.start = now_ns();
+    if(options.perf_counters && perf.leader != -1) perf_start();
+    result = run(code, elements);
+    if(options.perf_counters && perf.leader != -1) perf_stop();
+    if(checkpoint.writer > 0){ //The last snapshot is completed before the process ends
+        waitpid(checkpoint.writer, NULL, 0);
+        checkpoint.writer = 0;
+    }
+
+    if(io.record != NULL) fclose(io.record);
+    if(timing.out != stderr) fclose(timing.out);
+    if(options.record || options.replay) print_io_times(now_ns() - start);
+
+    if(options.trace && (result != 0 || trace_halted(code))) trace_dump(code);
+    if(options.sample) print_samples(filename, code, elements);
+    if(options.coverage) print_coverage(filename, code, elements);
+    if(options.profile) print_profile(filename, code, elements);
+    if(options.mem_stats){
+        print_mem_stats();
+        print_blocks(elements);
+    }
+    if(options.metrics) write_metrics(result);
+    if(options.perf_counters) print_perf();
+
+    return result;
+}
+
+void release_run(){ //The whole run is released by resetting the arenas
+    arena_reset(&stack_arena);
+    pool_reset(&var_pool);
+    arena_reset(&string_arena);
+    arena_reset(&program_arena);
+    module_count = 0;
+    free(blocks.ops);
+    blocks.ops = NULL;
+}
+
+//################################# - Watch section - ######################################################
+
+struct arena source_arena = {.name = "source"}; //The strings of the tokens kept between the runs
+
+int count_lines(char text[], long size){ //Counts the new lines
+    int lines = 0;
+
+    for(char *c = text; (c = memchr(c, '\n', text + size - c)) != NULL; c++) lines++;
+    return lines;
+}
+
+//Lexes the text, which begins at first_line, and copies the tokens in the arrays kept between the runs
+token *lex_text(char text[], long size, int first_line, int *comment, char state[], int *elements){
+    FILE *fp = fmemopen(text, size > 0 ? size : 1, "r");
+    token *code;
+
+    if(size == 0){ //fmemopen needs at least a byte, an empty range has no tokens
+        *elements = 0;
+        state[0] = *comment;
+        fclose(fp);
+        return NULL;
+    }
+
+    code = lex(fp, 0, first_line, comment, state, elements);
+    fclose(fp);
+
+    for(int i = 0; i < *elements; i++){
+        size_t len = strlen(code[i].string) + 1;
+        char *string = arena_alloc(&source_arena, len);
+
+        memcpy(string, code[i].string, len);
+        code[i].string = string;
+    }
+    return code;
+}
+
+int compare_label_positions(int a, int b){ //Compares two labels of the watched tokens like compare_labels
+    int c = strcmp(watch.code[a + 1].string, watch.code[b + 1].string);
+
+    return c != 0 ? c : (a > b) - (a < b);
+}
+
+void add_label(int position){ //Inserts the label in the ordered table
+    int low = 0, high = watch.label_count;
+
+    while(low < high){
+        int mid = (low + high) / 2;
+        if(compare_label_positions(watch.labels[mid], position) < 0) low = mid + 1;
+        else high = mid;
+    }
+    memmove(&watch.labels[low + 1], &watch.labels[low], (watch.label_count - low) * sizeof(int));
+    watch.labels[low] = position;
+    watch.label_count++;
+}
+
+void watch_load(char text[], long size){ //Lexes the whole file
+    int comment = 0;
+    int lines = count_lines(text, size);
+    char *state = malloc(lines + 2);
+    int elements;
+
+    arena_reset(&source_arena);
+    token *code = lex_text(text, size, 1, &comment, state + 1, &elements);
+
+    free(watch.code);
+    free(watch.state);
+    free(watch.labels);
+    free(watch.text);
+    watch.code = malloc((elements + 1) * sizeof(token));
+    if(elements > 0) memcpy(watch.code, code, elements * sizeof(token));
+    set_token(&watch.code[elements], "halt", 1 + lines, 0);
+    watch.elements = elements;
+    watch.state = state;
+    watch.lines = lines + 1;
+    watch.text = text;
+    watch.size = size;
+
+    watch.labels = malloc((elements + 1) * sizeof(int));
+    watch.label_count = 0;
+    for(int i = 0; i + 1 < elements; i++)
+        if(strncmp(watch.code[i].string, "label", D) == 0) add_label(i);
+}
+
+int first_token(int line){ //Position of the first kept token at the line or after it
+    int low = 0, high = watch.elements;
+
+    while(low < high){
+        int mid = (low + high) / 2;
+        if(watch.code[mid].line < line) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/*Lexes again only the lines between the first and the last byte that changed, starting in the state saved for the
+first of them. The tokens before are kept, the ones after are moved by the difference of lines. If the new lines
+end in a different state (a comment opened or closed) the whole file is lexed again. Returns the first lexed line
+and sets last to the line after the lexed ones, 0 if the text didn't change*/
+int watch_patch(char text[], long size, int *last){
+    long common = watch.size < size ? watch.size : size, prefix = 0, suffix = 0, start, end;
+
+    while(prefix + 4096 <= common && memcmp(watch.text + prefix, text + prefix, 4096) == 0) prefix += 4096; //Skips the equal blocks first
+    while(prefix < common && watch.text[prefix] == text[prefix]) prefix++;
+    if(prefix == common && watch.size == size){
+        free(text);
+        return 0;
+    }
+    while(suffix + 4096 <= common - prefix && memcmp(watch.text + watch.size - suffix - 4096, text + size - suffix - 4096, 4096) == 0) suffix += 4096;
+    while(suffix < common - prefix && watch.text[watch.size - 1 - suffix] == text[size - 1 - suffix]) suffix++;
+
+    for(start = prefix; start > 0 && text[start - 1] != '\n'; start--); //The lexing starts and ends on whole lines
+    char *newline = memchr(text + size - suffix, '\n', suffix);
+    end = newline != NULL ? newline - (text + size - suffix) + 1 : suffix;
+    suffix -= end; //The end of the last changed line is lexed again
+
+    int first = 1 + count_lines(text, start);
+    int old_next = first + count_lines(watch.text + start, watch.size - suffix - start); //The first line not lexed again
+    int new_lines = count_lines(text + start, size - suffix - start);
+    int comment = watch.state[first] == 1, elements;
+
+    if(watch.state[first] == 2 || (suffix > 0 && watch.state[old_next] == 2)){ //A string crosses the border
+        watch_load(text, size);
+        *last = watch.lines;
+        return 1;
+    }
+
+    char *state = malloc(new_lines + 2);
+    token *code = lex_text(text + start, size - suffix - start, first, &comment, state, &elements);
+
+    if(suffix > 0 && state[new_lines] != watch.state[old_next]){ //The rest of the file changed state
+        free(state);
+        watch_load(text, size);
+        *last = watch.lines;
+        return 1;
+    }
+
+    int t0 = first_token(first), t1 = suffix > 0 ? first_token(old_next) : watch.elements; //Without a suffix the lexing reaches the end
+    int shift = new_lines - (old_next - first), moved = elements - (t1 - t0);
+    int total = watch.elements + moved;
+    token *tokens = malloc((total + 1) * sizeof(token));
+    char *states = malloc(watch.lines + shift + 2);
+
+    memcpy(tokens, watch.code, t0 * sizeof(token));
+    if(elements > 0) memcpy(tokens + t0, code, elements * sizeof(token));
+    for(int i = t1; i <= watch.elements; i++){ //The halt is moved with the rest
+        tokens[i + moved] = watch.code[i];
+        tokens[i + moved].line += shift;
+    }
+
+    memcpy(states, watch.state, first);
+    memcpy(states + first, state, new_lines + 1);
+    memcpy(states + first + new_lines + 1, watch.state + old_next + 1, watch.lines - old_next);
+
+    int kept = 0; //The labels of the lexed tokens, and the one just before them, are replaced
+    for(int i = 0; i < watch.label_count; i++){
+        int position = watch.labels[i];
+
+        if(position < t0 - 1) watch.labels[kept++] = position;
+        else if(position >= t1) watch.labels[kept++] = position + moved;
+    }
+    free(watch.code);
+    free(watch.state);
+    free(watch.text);
+    free(state);
+    watch.code = tokens;
+    watch.elements = total;
+    watch.state = states;
+    watch.lines += shift;
+    watch.text = text;
+    watch.size = size;
+    watch.labels = realloc(watch.labels, (total + 1) * sizeof(int));
+    watch.label_count = kept;
+    for(int i = t0 > 0 ? t0 - 1 : 0; i < t0 + elements && i + 1 < total; i++)
+        if(strncmp(watch.code[i].string, "label", D) == 0) add_label(i);
+
+    *last = first + new_lines;
+    return first;
+}
+
+char *read_text(char filename[], long *size){ //Reads the whole file, NULL if it can't be read
+    FILE *fp = fopen(filename, "rb");
+    char *text;
+
+    if(fp == NULL) return NULL;
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if(*size < 0 || (text = malloc(*size + 1)) == NULL){
+        fclose(fp);
+        return NULL;
+    }
+    *size = fread(text, 1, *size, fp);
+    fclose(fp);
+    return text;
+}
+
+int watch_program(char filename[]){ //Runs the program every time its file is saved
+    char real[PATH_MAX], buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int fd = inotify_init();
+    long size;
+    char *text;
+
+    if(realpath(filename, real) == NULL || (text = read_text(real, &size)) == NULL){
+        printf("ERROR 2: The file does not exist\n");
+        return 2;
+    }
+
+    char *name = strrchr(real, '/') + 1;
+    name[-1] = '\0';
+    if(fd == -1 || inotify_add_watch(fd, real, IN_CLOSE_WRITE | IN_MOVED_TO) == -1){ //Editors often save by renaming a new file
+        printf("ERROR 2: The file can't be watched\n");
+        return 2;
+    }
+    name[-1] = '/';
+
+    watch_load(text, size);
+    while(1){ //Only a signal or an error ends it
+        execute(filename);
+        release_run();
+        fflush(stdout);
+
+        int changed = 0, first = 0, last;
+        while(!changed){
+            ssize_t len = read(fd, buffer, sizeof(buffer));
+
+            if(len == -1 && errno != EINTR){
+                printf("ERROR 2: The file can't be watched\n");
+                return 2;
+            }
+            for(char *c = buffer; len > 0 && c < buffer + len; c += sizeof(struct inotify_event) + ((struct inotify_event *)c)->len){
+                struct inotify_event *event = (struct inotify_event *)c;
+                if(event->len > 0 && strcmp(event->name, name) == 0) changed = 1;
+            }
+            if(!changed) continue;
+
+            long long start = now_ns();
+            if((text = read_text(real, &size)) == NULL){
+                printf("ERROR 2: The file %s can't be read\n", filename);
+                return 2;
+            }
+            if((first = watch_patch(text, size, &last)) == 0) changed = 0;
+            else fprintf(stderr, "\n--- %s changed, lines %d-%d lexed again in %.3f ms ---\n", filename, first, last - 1, (now_ns() - start) / 1e6);
+        }
+    }
+}
+
+//################################# - end of the section - #################################################
+
+//################################# - Shards section - #####################################################
+
+/*With --shard the input is split at its new lines in the given number of parts, and every part is read by a copy
+of the interpreter running in its own process: the state of the interpreter is global, so the processes are what
+keeps the copies apart. The outputs are printed in the order of the parts. With --reduce the final stacks of the
+parts, one over the other in the same order, become the stack of a last run that starts from the given label*/
+struct{
+    float *values; //The final stacks of the parts, from the bottom of the first one
+    int count;
+    int reducing; //Set during the run that merges the stacks
+    struct stack *stack; //The stack left by the last run
+}shards;
+
+char *load_stdin(long *size){ //Maps the input if it's a file, otherwise reads it all
+    struct stat st;
+    char *data = NULL;
+    long n, capacity = 0;
+
+    *size = 0;
+    if(fstat(0, &st) == 0 && S_ISREG(st.st_mode)){
+        off_t offset = lseek(0, 0, SEEK_CUR);
+
+        if(offset >= 0 && st.st_size - offset == 0) return "";
+        if(offset >= 0 && (data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, 0, 0)) != MAP_FAILED){
+            *size = st.st_size - offset;
+            return data + offset;
+        }
+        data = NULL;
+    }
+
+    do{
+        if(*size == capacity){
+            capacity = capacity ? capacity * 2 : ARENA_CHUNK;
+            if((data = realloc(data, capacity)) == NULL){
+                printf("ERROR 11: Out of memory\n");
+                exit(11);
+            }
+        }
+        n = read(0, data + *size, capacity - *size);
+        if(n > 0) *size += n;
+    }while(n > 0);
+
+    return data;
+}
+
+int run_shard(char filename[], char part[], long size, FILE *out, FILE *stack){ //The part becomes the input of the program
+    FILE *in = tmpfile();
+    int result;
+
+    if(in == NULL || fwrite(part, 1, size, in) != (size_t)size || fflush(in) != 0){
+        printf("ERROR 2: The input of the shard can't be created\n");
+        return 2;
+    }
+    lseek(fileno(in), 0, SEEK_SET);
+    dup2(fileno(in), 0);
+    dup2(fileno(out), 1);
+
+    result = execute(filename);
+    fflush(stdout);
+
+    if(result == 0 && options.reduce){ //The final stack is passed to the reduce
+        fwrite(&shards.stack->size, sizeof(int), 1, stack);
+        fwrite(shards.stack->values, sizeof(float), shards.stack->size, stack);
+        fflush(stack);
+    }
+
+    return result;
+}
+
+void stop_shards(pid_t pids[], FILE *outs[], FILE *stacks[], int started){ //Kills the parts already started
+    for(int k = 0; k < started; k++){
+        kill(pids[k], SIGKILL);
+        waitpid(pids[k], NULL, 0);
+        fclose(outs[k]);
+        fclose(stacks[k]);
+    }
+}
+
+int run_shards(char filename[]){
+    int parts = options.shard, result = 0;
+    long size, bounds[parts + 1];
+    char *data = load_stdin(&size);
+    FILE *outs[parts], *stacks[parts];
+    pid_t pids[parts];
+    char buffer[D];
+    size_t n;
+
+    bounds[0] = 0;
+    bounds[parts] = size;
+    for(int k = 1; k < parts; k++){ //Every part ends with a new line
+        long p = size / parts * k;
+
+        if(p < bounds[k - 1]) p = bounds[k - 1];
+        while(p > 0 && p < size && data[p - 1] != '\n') p++;
+        bounds[k] = p;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    for(int k = 0; k < parts; k++){
+        outs[k] = tmpfile();
+        stacks[k] = outs[k] != NULL ? tmpfile() : NULL;
+        if(stacks[k] == NULL || (pids[k] = fork()) == -1){
+            if(outs[k] != NULL) fclose(outs[k]);
+            if(stacks[k] != NULL) fclose(stacks[k]);
+            stop_shards(pids, outs, stacks, k); //Their output is thrown away, so it can't mix with the error
+            printf("ERROR 2: The shard %d can't be started\n", k);
+            return 2;
+        }
+        if(pids[k] == 0) _exit(run_shard(filename, data + bounds[k], bounds[k + 1] - bounds[k], outs[k], stacks[k]));
+    }
+
+    for(int k = 0; k < parts; k++){ //The outputs are printed in order, the first error becomes the result
+        int status;
+
+        waitpid(pids[k], &status, 0);
+        if(result == 0) result = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+        rewind(outs[k]);
+        while((n = fread(buffer, 1, D, outs[k])) > 0) fwrite(buffer, 1, n, stdout);
+        fclose(outs[k]);
+    }
+
+    if(result == 0 && options.reduce){
+        shards.values = malloc(sizeof(float));
+        for(int k = 0; k < parts; k++){
+            int count;
+
+            rewind(stacks[k]);
+            if(fread(&count, sizeof(int), 1, stacks[k]) != 1) continue;
+            if((shards.values = realloc(shards.values, (shards.count + count + 1) * sizeof(float))) == NULL){
+                printf("ERROR 11: Out of memory\n");
+                exit(11);
+            }
+            shards.count += fread(shards.values + shards.count, sizeof(float), count, stacks[k]);
+        }
+
+        shards.reducing = 1;
+        result = execute(filename);
+        release_run();
+        free(shards.values);
+    }
+
+    for(int k = 0; k < parts; k++) fclose(stacks[k]);
+    return result;
+}
+
+//################################# - end of the section - #################################################
+
+int main(int argc, char *argv[])
+{
+    int result;
+    char *filename = parse_options(argc, argv);
+
+    if(filename == NULL){
+        printf("ERROR 1: Invalid number of parameters\n");
+        return 1;
+    }
+
+    if(!valid_extension(filename)){
+        printf("ERROR 10: The file extension is not valid\n");
+        return 10;
+    }
+
+    if(options.watch) return watch_program(filename);
+    if(options.shard) return run_shards(filename);
+
+    result = execute(filename);
+    release_run();
+
+    return result;
+}
+
+int run(token code[], int elements){
+    node varstack = NULL; //Creates the head of the varstack
+    struct context *cx = new_context(LOOP_DEPTH, CALL_DEPTH, FRAMES_SIZE); //The registers of the running code
+    struct stack *stack = &cx->stack; //The stack of the running code
+    int start = 0;
+
+    memset(&coroutines, 0, sizeof(coroutines));
+    if(shards.reducing){ //The merged stacks of the shards are reduced from the given label
+        if((start = jump(code, elements, options.reduce)) == -1){
+            printf("ERROR 6: The label %s given to --reduce doesn't exist\n", options.reduce);
+            return 6;
+        }
+        start++;
+        for(int k = 0; k < shards.count; k++) push(stack, shards.values[k]);
+    }
+    if(options.checkpoint || options.restore){
+        checkpoint.hash = program_hash(code, elements);
+        checkpoint.varstack = &varstack;
+        checkpoint.cx = &cx;
+    }
+    if(options.restore){
+        int result = restore_checkpoint(elements, &start, stack, &varstack, cx);
+
+        if(result != 0) return result;
+    }
+    checkpoint_schedule();
+
+    //This cycle contains the actual interpretation of the given code
+    for(int i = start; i < elements; i++){
+        if(blocks.ops[i] == OP_NEW || blocks.ops[i] > OP_UNKNOWN) first_visit(code, elements, i);
+        if(instrumented) instrument(code, i, stack);
+        if(options.metrics){
+            metrics.opcodes[blocks.ops[i]]++;
+            if(metrics_requested){
+                metrics_requested = 0;
+                write_metrics(-1);
+            }
+        }
+
+        switch(blocks.ops[i]){
+            case OP_PUSH:
+                if(i + 1 < elements){
+                    if(real_number(code[i + 1].string)){ /*This check is needed because if the given string can't be turned in a number, the atoi functions returns 0
+                                                    but the user would like to insert 0, so if the argument of add is not a valid number, the interpreter will
+                                                    return an error.*/
+                        push(stack, atof(code[i + 1].string));
+                    }
+                    else{
+                        printf("ERROR 3: The argument at line %d is not a number\n", code[i].line);
+                        return 3;
+                    }
+                }
+                i++;
+                break;
+
+            case OP_POP:
+                if(!pop(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_DUP:
+                if(!pick(stack, 0)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_CLEAR:
+                clear(stack);
+                break;
+        
+            case OP_SWAP:
+                if(!roll(stack, 1)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_OVER:
+                if(!pick(stack, 1)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_ROT:
+                if(!roll(stack, 2)){
+                    printf("ERROR 5: The stack doesn't contain enough elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_PICK:{ //pick, roll and drop
+                float n;
+                int literal = repeat_literal(code, elements, i), result;
+
+                if(literal)
+                    n = atof(code[i + 1].string);
+                else if(!pop_value(stack, &n)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+
+                if(code[i].string[0] == 'p') result = pick(stack, n);
+                else if(code[i].string[0] == 'r') result = roll(stack, n);
+                else result = drop(stack, n);
+                if(!result){
+                    printf("ERROR 5: The stack doesn't contain enough elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                i += literal;
+                break;
+            }
+
+            case OP_DEPTH:
+                push(stack, stack->size);
+                break;
+
+            case OP_SUM:
+                if(!sum(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_SUB:
+                if(!sub(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_MULT:
+                if(!mult(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_DIV:
+                if(!my_div(stack)){
+                    printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+        
+            case OP_REM:
+                if(!rem(stack)){
+                    printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_TOINT:
+                if(!toint(stack)){
+                    printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_INC:
+                if(!inc(stack)){
+                    printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
+                    return 5;
+                }
+                if(code[i].match != -1){ //The back jump of a counting loop
+                    int next;
+
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i + 1);
+                    next = back_jump(code, i, stack);
+                    if(options.metrics) count_back_jump(code, elements, i, next);
+                    i = next;
+                }
+                break;
+
+            case OP_DEC:
+                if(!dec(stack)){
+                    printf("ERROR 5: Invalid Operation. The stack is either composed of less than 2 elements or the top element has a value of zero, line %d\n", code[i].line);
+                    return 5;
+                }
+                if(code[i].match != -1){ //The back jump of a counting loop
+                    int next;
+
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i + 1);
+                    next = back_jump(code, i, stack);
+                    if(options.metrics) count_back_jump(code, elements, i, next);
+                    i = next;
+                }
+                break;
+
+            case OP_AND:
+                if(!and(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_OR:
+                if(!or(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_NOT:
+                if(!not(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_XOR:
+                if(!xor(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_LSHIFT:
+                if(!lshift(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_RSHIFT:
+                if(!rshift(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_PRINT:
+                if(i + 1 < elements){
+                    int len = strlen(code[i + 1].string);
+                    char temp[len];
+                    if(i + 1 < elements && code[i + 1].string[0] == '\"' && code[i + 1].string[len - 1] == '\"'){
+                        prepare_string(code[i + 1].string, len, temp);
+                        output_bytes += printf("%s", temp);
+                    }
+                    else{
+                        printf("ERROR 6: The argument at line %d is not a string\n", code[i].line);
+                        return 6;
+                    }
+                }
+                i++; //Skips to the next instruction
+                continue;
+
+            case OP_PRINTNL:
+                if(i + 1 < elements){
+                    int len = strlen(code[i + 1].string);
+                    char temp[len];
+                    if(i + 1 < elements && code[i + 1].string[0] == '\"' && code[i + 1].string[len - 1] == '\"'){
+                        prepare_string(code[i + 1].string, len, temp);
+                        output_bytes += printf("%s\n", temp);
+                    }
+                    else{
+                        printf("ERROR 6: The argument at line %d is not a string\n", code[i].line);
+                        return 6;
+                    }
+                }
+                i++; //Skips to the next instruction, avoiding the argument
+                continue;
+
+            case OP_IN:
+                if(!read_input(stack, 0)) return input_missing(code, i);
+                break;
+
+            case OP_INCHAR:
+                if(!read_input(stack, 1)) return input_missing(code, i);
+                break;
+
+            case OP_EOF:
+                push(stack, input_ended());
+                break;
+
+            case OP_OUT:
+                if(!out(stack, 0)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_OUTINT:
+                if(!out(stack, 1)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_OUTCHAR:
+                if(!out(stack, 2)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_SCLEAR:
+                sclear();
+                break;
+
+            case OP_IFEQ:{
+                int result = if_eq(stack);
+            
+                if(result == -1){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+
+                if(result == 0){ //Jumps to the endif
+                    metrics.false_ifs++;
+                    i = code[i].match;
+                }
+                else if(code[i].slot != -1){ //The body is only a goto, taken here
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i + 1);
+                    if(options.metrics) metrics.opcodes[OP_JUMP]++;
+                    i = code[i].slot;
+                }
+                break;
+            }
+
+            case OP_IFDIF:{
+                int result = if_dif(stack);
+            
+                if(result == -1){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+
+                if(result == 0){ //Jumps to the endif
+                    metrics.false_ifs++;
+                    i = code[i].match;
+                }
+                else if(code[i].slot != -1){ //The body is only a goto, taken here
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i + 1);
+                    if(options.metrics) metrics.opcodes[OP_JUMP]++;
+                    i = code[i].slot;
+                }
+                break;
+            }
+
+            case OP_IFGR:{
+                int result = if_gr(stack);
+            
+                if(result == -1){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+
+                if(result == 0){ //Jumps to the endif
+                    metrics.false_ifs++;
+                    i = code[i].match;
+                }
+                else if(code[i].slot != -1){ //The body is only a goto, taken here
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i + 1);
+                    if(options.metrics) metrics.opcodes[OP_JUMP]++;
+                    i = code[i].slot;
+                }
+                break;
+            }
+
+            case OP_IFLW:{
+                int result = if_lw(stack);
+            
+                if(result == -1){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+
+                if(result == 0){ //Jumps to the endif
+                    metrics.false_ifs++;
+                    i = code[i].match;
+                }
+                else if(code[i].slot != -1){ //The body is only a goto, taken here
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i + 1);
+                    if(options.metrics) metrics.opcodes[OP_JUMP]++;
+                    i = code[i].slot;
+                }
+                break;
+            }
+
+            case OP_IFTRUE:{
+                int result = if_true(stack);
+            
+                if(result == -1){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+
+                if(result == 0){ //Jumps to the endif
+                    metrics.false_ifs++;
+                    i = code[i].match;
+                }
+                else if(code[i].slot != -1){ //The body is only a goto, taken here
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i + 1);
+                    if(options.metrics) metrics.opcodes[OP_JUMP]++;
+                    i = code[i].slot;
+                }
+                break;
+            }
+
+            case OP_IFFALSE:{
+                int result = if_false(stack);
+            
+                if(result == -1){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+
+                if(result == 0){ //Jumps to the endif
+                    metrics.false_ifs++;
+                    i = code[i].match;
+                }
+                else if(code[i].slot != -1){ //The body is only a goto, taken here
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i + 1);
+                    if(options.metrics) metrics.opcodes[OP_JUMP]++;
+                    i = code[i].slot;
+                }
+                break;
+            }
+
+            case OP_ENDIF:
+                continue; //Does nothing
+
+            case OP_REPEAT:{
+                long count;
+                double value;
+
+                if(repeat_literal(code, elements, i))
+                    value = atof(code[i + 1].string);
+                else{
+                    float top;
+
+                    if(!pop_value(stack, &top)){
+                        printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                        return 4;
+                    }
+                    value = top;
+                }
+                if(!iteration_count(value, &count)){
+                    printf("ERROR 3: The number of iterations is not valid, line %d\n", code[i].line);
+                    return 3;
+                }
+
+                while(cx->loop_top > cx->loop_floor && cx->loops[cx->loop_top - 1].start >= i) cx->loop_top--; //Discards the loops left with a goto
+
+                if(count <= 0){ //The body is skipped
+                    i = code[i].match;
+                    continue;
+                }
+
+                if(cx->loop_top == cx->loop_depth){
+                    printf("ERROR 12: Too many nested loops, line %d\n", code[i].line);
+                    return 12;
+                }
+                cx->loops[cx->loop_top].start = i;
+                cx->loops[cx->loop_top].body = repeat_literal(code, elements, i) ? i + 2 : i + 1;
+                cx->loops[cx->loop_top].remaining = count;
+                cx->loops[cx->loop_top].index = 0;
+                i = cx->loops[cx->loop_top++].body - 1;
+                break;
+            }
+
+            case OP_ENDREPEAT:{
+                while(cx->loop_top > cx->loop_floor && cx->loops[cx->loop_top - 1].start != code[i].match) cx->loop_top--;
+
+                if(cx->loop_top == cx->loop_floor){
+                    printf("ERROR 12: The endrepeat at line %d is not inside a running loop\n", code[i].line);
+                    return 12;
+                }
+
+                struct loop *lp = &cx->loops[cx->loop_top - 1];
+                if(--lp->remaining > 0){ //Decrements and jumps back to the body
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i);
+                    lp->index++;
+                    i = lp->body - 1;
+                }
+                else
+                    cx->loop_top--;
+                break;
+            }
+
+            case OP_WHILE:{
+                int result = loop_condition(code[i + 1].string, stack);
+
+                if(result == -1){
+                    printf("ERROR 5: The stack doesn't contain enough elements, line %d\n", code[i].line);
+                    return 5;
+                }
+
+                while(cx->loop_top > cx->loop_floor && cx->loops[cx->loop_top - 1].start >= i) cx->loop_top--;
+
+                if(result == 0){
+                    i = code[i].match;
+                    continue;
+                }
+
+                if(cx->loop_top == cx->loop_depth){
+                    printf("ERROR 12: Too many nested loops, line %d\n", code[i].line);
+                    return 12;
+                }
+                cx->loops[cx->loop_top].start = i;
+                cx->loops[cx->loop_top].body = i + 2;
+                cx->loops[cx->loop_top].remaining = 0;
+                cx->loops[cx->loop_top].index = 0;
+                cx->loop_top++;
+                i++; //Skips the condition
+                break;
+            }
+
+            case OP_ENDWHILE:{
+                while(cx->loop_top > cx->loop_floor && cx->loops[cx->loop_top - 1].start != code[i].match) cx->loop_top--;
+
+                if(cx->loop_top == cx->loop_floor){
+                    printf("ERROR 12: The endwhile at line %d is not inside a running loop\n", code[i].line);
+                    return 12;
+                }
+
+                struct loop *lp = &cx->loops[cx->loop_top - 1];
+                int result = loop_condition(code[lp->start + 1].string, stack);
+
+                if(result == -1){
+                    printf("ERROR 5: The stack doesn't contain enough elements, line %d\n", code[i].line);
+                    return 5;
+                }
+
+                if(result == 1){ //Checks the condition and jumps back to the body
+                    if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i);
+                    lp->index++;
+                    i = lp->body - 1;
+                }
+                else
+                    cx->loop_top--;
+                break;
+            }
+
+            case OP_INDEX:
+                if(cx->loop_top == cx->loop_floor){
+                    printf("ERROR 12: The index at line %d is not inside a running loop\n", code[i].line);
+                    return 12;
+                }
+                push(stack, cx->loops[cx->loop_top - 1].index);
+                break;
+
+            case OP_CALL:
+                if(cx->call_top == cx->call_depth || cx->frames_top + code[i].slot > cx->frames_size){
+                    printf("ERROR 13: Too many nested calls, line %d\n", code[i].line);
+                    return 13;
+                }
+
+                cx->calls[cx->call_top].ret = i + 1; //The position of the label name, the cycle moves to the next instruction
+                cx->calls[cx->call_top].base = cx->frames_top;
+                cx->calls[cx->call_top].loop_floor = cx->loop_floor;
+                cx->call_top++;
+
+                for(int k = 0; k < code[i].slot; k++) cx->frames[cx->frames_top + k] = 0; //The local variables start from 0
+                cx->frames_top += code[i].slot;
+                cx->loop_floor = cx->loop_top;
+
+                i = code[i].match;
+                break;
+
+            case OP_RET:
+                if(cx->call_top == 0 && cx->caller != NULL){ //The coroutine ends, giving its top element like a yield
+                    struct context *caller = cx->caller;
+                    float value;
+
+                    if(!pop_value(stack, &value)){
+                        printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                        return 4;
+                    }
+                    end_coroutine(cx);
+
+                    cx = caller;
+                    i = cx->pc;
+                    stack = &cx->stack;
+                    push(stack, value);
+                    continue;
+                }
+
+                if(cx->call_top == 0){
+                    printf("ERROR 13: The ret at line %d is not inside a call\n", code[i].line);
+                    return 13;
+                }
+
+                cx->call_top--;
+                cx->frames_top = cx->calls[cx->call_top].base;
+                cx->loop_top = cx->loop_floor; //The loops of the subroutine end with it
+                cx->loop_floor = cx->calls[cx->call_top].loop_floor;
+                i = cx->calls[cx->call_top].ret;
+                break;
+
+            case OP_COCREATE:{
+                float handle;
+
+                if(!cocreate(code[i].match, &handle)){
+                    printf("ERROR 18: Too many coroutines, line %d\n", code[i].line);
+                    return 18;
+                }
+                push(stack, handle);
+                i++;
+                break;
+            }
+
+            case OP_RESUME:{
+                struct context *next;
+                float handle, value;
+
+                if(!pop_value(stack, &handle) || !pop_value(stack, &value)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                if((next = coroutine(handle)) == NULL){
+                    printf("ERROR 18: The coroutine resumed at line %d doesn't exist or has ended\n", code[i].line);
+                    return 18;
+                }
+                if(next->caller != NULL){
+                    printf("ERROR 18: The coroutine resumed at line %d is already running\n", code[i].line);
+                    return 18;
+                }
+
+                cx->pc = i; //Only the position and the stack change with the coroutine
+                next->caller = cx;
+                cx = next;
+                i = cx->pc;
+                stack = &cx->stack;
+                push(stack, value);
+                break;
+            }
+
+            case OP_YIELD:{
+                struct context *caller = cx->caller;
+                float value;
+
+                if(caller == NULL){
+                    printf("ERROR 18: The yield at line %d is not inside a coroutine\n", code[i].line);
+                    return 18;
+                }
+                if(!pop_value(stack, &value)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+
+                cx->pc = i;
+                cx->caller = NULL;
+                cx = caller;
+                i = cx->pc;
+                stack = &cx->stack;
+                push(stack, value);
+                break;
+            }
+
+            case OP_LOCAL:
+                i++; //The local variables are created by the call
+                break;
+
+            case OP_SHVAR:
+                if((shm.bound[code[i].shared] = shared_entry(code[i + 1].string)) == NULL){
+                    printf("ERROR 20: The shared memory segment is full, line %d\n", code[i].line);
+                    return 20;
+                }
+                i++;
+                break;
+
+            case OP_SHARED:{ //load, store, pstore, fetchadd and cas of a shared variable
+                struct shared_var *v = shm.bound[code[i].shared];
+                char *op = code[i].string;
+                float value, expected;
+
+                if(v == NULL){
+                    printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
+                    return 7;
+                }
+
+                if(op[0] == 'l')
+                    push(stack, bits_float(atomic_load(&v->bits)));
+                else if(op[0] == 'c'){ //The expected value is below the new one
+                    if(!pop_value(stack, &value) || !pop_value(stack, &expected)){
+                        printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                        return 5;
+                    }
+                    push(stack, shared_cas(v, expected, value));
+                }
+                else if(!top_value(stack, &value)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                else if(op[0] == 'f'){
+                    pop(stack);
+                    push(stack, shared_add(v, value));
+                }
+                else{
+                    atomic_store(&v->bits, float_bits(value));
+                    if(op[0] == 'p') pop(stack);
+                }
+                i++;
+                break;
+            }
+
+            case OP_LOCAL_VAR:{ //The variable is a local one
+                if(cx->call_top == 0){
+                    printf("ERROR 13: The local variable at line %d is used outside of a call\n", code[i].line);
+                    return 13;
+                }
+
+                float *var = &cx->frames[cx->calls[cx->call_top - 1].base + code[i].slot];
+
+                if(code[i].string[0] == 'l')
+                    push(stack, *var);
+                else{
+                    if(!top_value(stack, var)){
+                        printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                        return 4;
+                    }
+                    if(code[i].string[0] == 'p') pop(stack);
+                }
+                i++;
+                break;
+            }
+
+            case OP_JUMP:
+                if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i);
+                i = code[i].match; //The label has been found by the linker
+                break;
+
+            case OP_GOTO:{
+                int j;
+
+                if((i + 1) >= elements){ //Checks for the existence of the label
+                    printf("ERROR 6: The label at line %d doesn't exist\n", code[i].line);
+                    return 6;
+                }
+
+
+                if((j = jump(code, elements, code[i + 1].string)) == -1){
+                    printf("ERROR 6: The label at line %d doesn't exist\n", code[i].line);
+                    return 6;
+                }
+                if((++steps > step_limit || expired) && !checkpoint_step()) return limit_exceeded(code, i);
+                i = j;
+                break;
+            }
+
+            case OP_VAR:
+                if(i + 1 < elements){
+                    new_var(&varstack, code[i + 1].string); //Sets the default variable value to 0
+                    i++;
+                }
+                break;
+
+            case OP_STORE:
+                if(i + 1 < elements){
+                    if(stack->size == 0){
+                        printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                        return 4;
+                    }
+
+                    if(!store(varstack, stack, code[i + 1].string)){
+                        printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
+                        return 7;
+                    }
+                }
+                i++;
+                break;
+
+            case OP_PSTORE:
+                if(i + 1 < elements){
+                    if(stack->size == 0){
+                        printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                        return 4;
+                    }
+
+                    if(!store(varstack, stack, code[i + 1].string)){
+                        printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
+                        return 7;
+                    }
+                }
+                pop(stack);
+                i++;
+                break;
+
+            case OP_LOAD:
+                if(i + 1 < elements && code[i].match != -1){ //The load is inside a loop
+                    struct binding *b = &optimizer.bindings[code[i].match];
+
+                    if(b->var == NULL || b->generation != var_generation){
+                        b->var = find_var(varstack, code[i + 1].string);
+                        b->generation = var_generation;
+                    }
+                    if(b->var == NULL){
+                        printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
+                        return 7;
+                    }
+                    push(stack, b->var->value);
+                }
+                else if(i + 1 < elements){
+                    if(!load(varstack, stack, code[i + 1].string)){
+                        printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
+                        return 7;
+                    }
+                }
+                i++;
+                break;
+
+            case OP_DEL:
+                if(i + 1 < elements){
+                    if(!delete_var(&varstack, code[i + 1].string)){
+                        printf("ERROR 7: The variable at line %d doesn't exists\n", code[i].line);
+                        return 7;
+                    }
+                }
+                i++;
+                break;
+
+            case OP_RANDINT:
+                if(i + 1 < elements){
+                    if(real_number(code[i + 1].string)){
+                        unsigned int seed;
+
+                        if(!next_seed(&seed)) return replay_mismatch(code, i);
+                        randint(stack, atof(code[i + 1].string), seed);
+                    }
+                    else{
+                        printf("ERROR 3: The argument at line %d is not a number\n", code[i].line);
+                        return 3;
+                    }
+                }
+                i++;
+                break;
+
+            case OP_VCLEAR:
+                clear(stack);
+                break;
+
+            case OP_ABS:
+                if(!my_abs(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_POW:
+                if(!my_pow(stack)){
+                    printf("ERROR 5: The stack is composed of less than 2 elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+
+            case OP_LN:
+                if(!ln(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_LOG:
+                if(!my_log(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_CEIL:
+                if(!my_ceil(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_LOGTWO:
+                if(!logtw(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_SQRT:
+                if(!my_sqrt(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_SIN:
+                if(!my_sin(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_COS:
+                if(!my_cos(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_TAN:
+                if(!my_tan(stack)){
+                    printf("ERROR 4: The stack is empty, line %d\n", code[i].line);
+                    return 4;
+                }
+                break;
+
+            case OP_STACK:
+                printlist(stack);
+                break;
+
+            case OP_SORT:{
+                int mode = code[i].string[0] == 's' ? SORT_ASCENDING : code[i].string[0] == 'r' ? SORT_DESCENDING : SORT_UNIQUE;
+                int n = -1;
+
+                if(repeat_literal(code, elements, i)){ //Only the top elements are sorted
+                    double value = atof(code[i + 1].string);
+
+                    if(!(value >= 0)){ //A NaN fails it too
+                        printf("ERROR 3: The argument at line %d is not a number\n", code[i].line);
+                        return 3;
+                    }
+                    if(value > stack->size){ //Checked before the conversion, which can't hold any number
+                        printf("ERROR 5: The stack doesn't contain enough elements, line %d\n", code[i].line);
+                        return 5;
+                    }
+                    n = value;
+                    i++;
+                }
+
+                if(!sort(stack, n, mode)){
+                    printf("ERROR 5: The stack doesn't contain enough elements, line %d\n", code[i].line);
+                    return 5;
+                }
+                break;
+            }
+
+            case OP_CLOCK:
+                push(stack, now_ns() - timing.start);
+                break;
+
+            case OP_MARK:
+                if(i + 1 < elements) timing.marks[code[i].slot] = now_ns();
+                i++;
+                break;
+
+            case OP_ELAPSED:{
+                long long ns;
+
+                if(i + 1 < elements){
+                    if(!since_mark(code, i, &ns)){
+                        printf("ERROR 17: The mark at line %d has not been saved\n", code[i].line);
+                        return 17;
+                    }
+
+                    if(code[i].string[0] == 'e') push(stack, ns);
+                    else fprintf(timing.out, "%s %lld\n", code[i + 1].string, ns);
+                }
+                i++;
+                break;
+            }
+            case OP_LABEL:
+                if((i + 1) > elements){
+                    printf("ERROR 6: The label at line %d doesn't exist\n", code[i].line);
+                    return 6;
+                }
+                i++;
+                break;
+
+            case OP_HALT:
+                i = elements; //Ends the cycle
+                break;
+
+            default: //Unknown instruction
+                printf("ERROR 8: Unknown token in line %d\n", code[i].line);
+                return 8;
+
+        }
+    }
 
+    shards.stack = stack; //Read by the shards for the reduce
     return 0;
 }
\ No newline at end of file